@@ -9,6 +9,7 @@
 #include <avr/eeprom.h>       // for accessing data in eeprom
 #include <avr/power.h>        // for enabling/disabling microcontroller modules
 #include <util/delay_basic.h> // for the _delay_loop_1() macro
+#include <util/atomic.h>      // for noninterruptable blocks
 
 
 #include "alarm.h"
@@ -24,6 +25,10 @@
 volatile alarm_t alarm;
 
 
+// private function declarations
+uint16_t alarm_countdown(void);
+
+
 // default alarm times
 uint8_t ee_alarm_hours[ALARM_COUNT] EEMEM = {
     [0 ... ALARM_COUNT - 1] = ALARM_DEFAULT_HOUR
@@ -99,6 +104,11 @@ void alarm_wake(void) {
 	display_autodim();
     }
 
+    // sample alarm switch again only after it changes
+    alarm.switch_timer = 0;
+    PCMSK2 |= _BV(PCINT18);
+    PCICR  |= _BV(PCIE2);
+
     if(alarm.status & ALARM_SOUNDING) {
 	// lower volume which may be raised above
 	// volume_max during sleep mode
@@ -110,6 +120,13 @@ void alarm_wake(void) {
 
 // prepare alarm for sleep
 void alarm_sleep(void) {
+    // check alarms on next tick during sleep
+    alarm.sleep_due = 1;
+
+    // disable alarm switch pin change interrupt
+    PCMSK2 &= ~_BV(PCINT18);
+    if(!PCMSK2) PCICR &= ~_BV(PCIE2);
+
     // clamp alarm switch pin to ground
     PORTD &= ~_BV(PD2); // disable pull-up resistor
     DDRD  |=  _BV(PD2); // set as ouput, clamped to ground
@@ -126,6 +143,16 @@ void alarm_sleep(void) {
 
 // sound alarm at the correct time if alarm is set
 void alarm_tick(void) {
+    // during sleep, skip checks until next alarm or hour
+    if(system.status & SYSTEM_SLEEP
+	    && !(alarm.status & (ALARM_SOUNDING | ALARM_SNOOZE))
+	    && --alarm.sleep_due) {
+	return;
+    }
+
+    // calendar updates may be deferred during sleep
+    time_normalize();
+
     // will be set to TRUE if alarm should be triggered
     uint8_t is_alarm_trigger = FALSE;
     
@@ -204,36 +231,82 @@ void alarm_tick(void) {
 
 	++alarm.alarm_timer;
     }
+
+    if(system.status & SYSTEM_SLEEP) alarm.sleep_due = alarm_countdown();
 }
 
 
-// queries alarm switch and updates alarm status
+// returns seconds until the next alarm or the start of the next
+// hour, whichever is sooner; alarms are checked again at the start
+// of each hour, since daylight saving time may change the time
+uint16_t alarm_countdown(void) {
+    uint16_t due = time_nexthour();
+    uint8_t  wday = time_dayofweek(time.year, time.month, time.day);
+
+    for(uint8_t i = 0; i < ALARM_COUNT; ++i) {
+	if((alarm.days[i] & ALARM_ENABLED)
+		&& (alarm.days[i] & _BV(wday))
+		&& alarm.hours[i] == time.hour
+		&& alarm.minutes[i] > time.minute) {
+	    uint16_t seconds = (alarm.minutes[i] - time.minute) * 60
+			       - time.second;
+	    if(seconds < due) due = seconds;
+	}
+    }
+
+    return due;
+}
+
+
+#ifdef TICKLESS_SLEEP
+// returns seconds until alarm_tick() must next run during sleep:
+// every second while sounding, at snooze expiry, and otherwise
+// when alarm_tick() next checks alarms (alarm.sleep_due)
+uint8_t alarm_due(void) {
+    if(alarm.status & ALARM_SOUNDING) return 1;
+
+    uint8_t due = UINT8_MAX;
+
+    if(alarm.status & ALARM_SNOOZE) {
+	if(alarm.alarm_timer >= alarm.snooze_time) return 1;
+
+	uint16_t remaining = alarm.snooze_time - alarm.alarm_timer;
+	if(remaining < due) due = remaining;
+    }
+
+    if(alarm.sleep_due < due) due = alarm.sleep_due;
+
+    return due;
+}
+
+
+#endif  // TICKLESS_SLEEP
+// queries alarm switch once it has settled after a
+// pin change and updates alarm status
 void alarm_semitick(void) {
-    // update alarm status if alarm switch has changed
-    static uint8_t alarm_debounce = 0;
+    uint8_t settled = 0;
+
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	if(alarm.switch_timer && !--alarm.switch_timer) settled = 1;
+    }
+
+    if(!settled) return;
 
+    // update alarm status if alarm switch has changed
     if(PIND & _BV(PD2)) {
-	if(alarm.status & ALARM_SET) {
-	    alarm_debounce = 0;
-	} else {
-	    if(++alarm_debounce >= ALARM_DEBOUNCE_TIME) {
-		alarm.status |= ALARM_SET;
-		mode_alarmset();
-		display_onbutton();
-	    }
+	if(!(alarm.status & ALARM_SET)) {
+	    alarm.status |= ALARM_SET;
+	    mode_alarmset();
+	    display_onbutton();
 	}
     } else {
 	if(alarm.status & ALARM_SET) {
-	    if(++alarm_debounce >= ALARM_DEBOUNCE_TIME) {
-		if(alarm.status & ALARM_SOUNDING) piezo_alarm_stop();
-		alarm.status &= ~ALARM_SET & ~ALARM_SOUNDING & ~ALARM_SNOOZE;
-		display.status &= ~DISPLAY_PULSING;
-		display_autodim();
-		mode_alarmoff();
-		display_onbutton();
-	    }
-	} else {
-	    alarm_debounce = 0;
+	    if(alarm.status & ALARM_SOUNDING) piezo_alarm_stop();
+	    alarm.status &= ~ALARM_SET & ~ALARM_SOUNDING & ~ALARM_SNOOZE;
+	    display.status &= ~DISPLAY_PULSING;
+	    display_autodim();
+	    mode_alarmoff();
+	    display_onbutton();
 	}
     }
 }
@@ -64,6 +64,12 @@ typedef struct {
     uint8_t  volume_max;   // maximum sound volume of buzzer
     uint8_t  ramp_time;    // ramp time for progressive alarm (minutes)
     uint16_t ramp_int;     // ramp interval for progressive alarm (seconds)
+
+    uint16_t sleep_due;    // during sleep, seconds until alarms must
+    			   // next be checked
+
+    uint8_t  switch_timer; // semiseconds until alarm switch is sampled;
+    			   // zero when awaiting a pin change
 } alarm_t;
 
 
@@ -79,6 +85,15 @@ void alarm_sleep(void);
 void alarm_tick(void);
 void alarm_semitick(void);
 
+// called from pin change interrupt; restarts alarm switch debounce
+static inline void alarm_pcint(void) {
+    alarm.switch_timer = ALARM_DEBOUNCE_TIME;
+}
+
+#ifdef TICKLESS_SLEEP
+uint8_t alarm_due(void);
+#endif  // TICKLESS_SLEEP
+
 void alarm_savealarm(uint8_t idx);
 void alarm_loadalarm(uint8_t idx);
 void alarm_savevolume(void);
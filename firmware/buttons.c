@@ -1,5 +1,12 @@
 // buttons.c  --  button press detection
-// (button presses are processed in mode.c)
+// (button events are processed in mode.c)
+//
+// Button pins are sampled only after a pin change interrupt, so idle
+// buttons cost nothing.  The first edge is reported immediately; the
+// pins are then ignored until resampled after the debounce time.  In
+// modes with chords, a press is instead held for the chord time, so
+// buttons pressed together are reported as a single press rather than
+// a press and a chord.
 //
 // Note that PD5 is the default menu button pin, but PC4 is used
 // instead when the anode-cathode to-spec hack is enabled.
@@ -13,7 +20,8 @@
 //
 
 
-#include <avr/io.h>  // for using avr register names
+#include <avr/io.h>      // for using avr register names
+#include <util/atomic.h> // for noninterruptable blocks
 
 
 #include "buttons.h"
@@ -27,18 +35,24 @@
 #define MENU_PORT PORTB
 #define MENU_DDR  DDRB
 #define MENU_PIN  PINB
+#define MENU_PCMSK PCMSK0
+#define MENU_PCIE  PCIE0
 
 // set button bit and registers
 #define SET_BIT  PD4
 #define SET_PORT PORTD
 #define SET_DDR  DDRD
 #define SET_PIN  PIND
+#define SET_PCMSK PCMSK2
+#define SET_PCIE  PCIE2
 
 // plus button bit and registers
 #define PLUS_BIT  PD3
 #define PLUS_PORT PORTD
 #define PLUS_DDR  DDRD
 #define PLUS_PIN  PIND
+#define PLUS_PCMSK PCMSK2
+#define PLUS_PCIE  PCIE2
 
 #else
 
@@ -48,11 +62,15 @@
 #define MENU_PORT PORTB
 #define MENU_DDR  DDRB
 #define MENU_PIN  PINB
+#define MENU_PCMSK PCMSK0
+#define MENU_PCIE  PCIE0
 #else
 #define MENU_BIT  PD5
 #define MENU_PORT PORTD
 #define MENU_DDR  DDRD
 #define MENU_PIN  PIND
+#define MENU_PCMSK PCMSK2
+#define MENU_PCIE  PCIE2
 #endif  // VFD_TO_SPEC
 
 // set button bit and registers
@@ -60,12 +78,16 @@
 #define SET_PORT PORTB
 #define SET_DDR  DDRB
 #define SET_PIN  PINB
+#define SET_PCMSK PCMSK0
+#define SET_PCIE  PCIE0
 
 // plus button bit and registers
 #define PLUS_BIT  PD4
 #define PLUS_PORT PORTD
 #define PLUS_DDR  DDRD
 #define PLUS_PIN  PIND
+#define PLUS_PCMSK PCMSK2
+#define PLUS_PCIE  PCIE2
 
 #endif  // XMAS_DESIGN
 
@@ -76,13 +98,20 @@ volatile buttons_t buttons;
 
 // set initial state after system reset
 void buttons_init(void) {
-    buttons.state = buttons.pressed = 0;
+    buttons.pressed = 0;
     buttons_sleep(); // clamp button pins to ground
 }
 
 
 // clamp button pins to ground
 void buttons_sleep(void) {
+    // disable pin change interrupts
+    MENU_PCMSK &= ~_BV(MENU_BIT);
+    SET_PCMSK  &= ~_BV(SET_BIT);
+    PLUS_PCMSK &= ~_BV(PLUS_BIT);
+    if(!PCMSK0) PCICR &= ~_BV(PCIE0);
+    if(!PCMSK2) PCICR &= ~_BV(PCIE2);
+
     // disable pull-up resistors
     MENU_PORT &= ~_BV(MENU_BIT);
     SET_PORT  &= ~_BV(SET_BIT);
@@ -106,11 +135,35 @@ void buttons_wake(void) {
     MENU_PORT |= _BV(MENU_BIT);
     SET_PORT  |= _BV(SET_BIT);
     PLUS_PORT |= _BV(PLUS_BIT);
+
+    // discard events from before sleep; buttons held
+    // during wake are sampled after the debounce time
+    buttons.pressed = buttons.queue_head = buttons.queue_tail = 0;
+    buttons.chord_timer = 0;
+    buttons.debounce_timer = BUTTONS_DEBOUNCE_TIME;
+
+    // enable pin change interrupts
+    MENU_PCMSK |= _BV(MENU_BIT);
+    SET_PCMSK  |= _BV(SET_BIT);
+    PLUS_PCMSK |= _BV(PLUS_BIT);
+    PCICR |= _BV(MENU_PCIE) | _BV(SET_PCIE) | _BV(PLUS_PCIE);
 }
 
 
-// check for button presses every semisecond
-void buttons_semitick(void) {
+// add event to button event queue; event is dropped if queue is full
+static void buttons_push(uint8_t event) {
+    uint8_t head = (buttons.queue_head + 1) & (BUTTONS_QUEUE_SIZE - 1);
+
+    if(head != buttons.queue_tail) {
+	buttons.queue[buttons.queue_head] = event;
+	buttons.queue_head = head;
+    }
+}
+
+
+// sample button pins and queue events for any changes;
+// must be called with interrupts disabled
+static void buttons_sample(void) {
     uint8_t sensed = 0;  // which buttons are pressed?
 
     // check the menu button (button one)
@@ -122,55 +175,116 @@ void buttons_semitick(void) {
     // check the set button (button two)
     if(!(SET_PIN & _BV(SET_BIT))) sensed |= BUTTONS_SET;
 
-    // timers for button debouncing and repeating
-    static uint8_t debounce_timer = 0;
-    static uint16_t pressed_timer = 0;
+    if(sensed == buttons.pressed) return;
 
-    // debounce before storing the currently pressed buttons
-    if(buttons.pressed != sensed && (buttons.state & 0x0F) == sensed) {
-	if(++debounce_timer >= BUTTONS_DEBOUNCE_TIME) {
-	    buttons.pressed = sensed;
-	    buttons.state &= 0x0F;  // clear process and repeating flags
-	    pressed_timer = 0;
-	}
-    } else {
-	buttons.state &= 0xF0;   // clear button flags
-	buttons.state |= sensed; // set new button flags
-	debounce_timer = 0;
+    uint8_t released = buttons.pressed & ~sensed;
+    uint8_t added    = sensed & ~buttons.pressed;
+
+    // a pending press is reported before any release, so
+    // quick taps are not lost
+    if(released && buttons.chord_timer) {
+	buttons_push(BUTTONS_PRESS | buttons.pressed);
+	buttons.chord_timer = 0;
     }
 
-    // if any buttons are pressed, periodically clear processed flag
-    // to allow for press-and-hold repeating
-    if(buttons.pressed) {
-	++pressed_timer;
+    if(released) buttons_push(BUTTONS_RELEASE | released);
 
-	if(buttons.state & BUTTONS_REPEATING) {
-	    if(pressed_timer >= BUTTONS_REPEAT_RATE) {
-		buttons.state &= ~BUTTONS_PROCESSED;
-		pressed_timer = 0;
-	    }
+    // if chords are used, hold new presses for the chord time;
+    // buttons added meanwhile join the pending press
+    if(added && added == sensed) {
+	if(buttons.chord_hold) {
+	    buttons.chord_timer = BUTTONS_CHORD_TIME;
 	} else {
-	    if(pressed_timer >= BUTTONS_REPEAT_AFTER) {
-		buttons.state |= BUTTONS_REPEATING;
-	    }
+	    buttons_push(BUTTONS_PRESS | sensed);
 	}
+    } else if(added && !buttons.chord_timer) {
+	buttons_push(BUTTONS_CHORD | sensed);
+    }
+
+    buttons.pressed        = sensed;
+    buttons.repeat_timer   = BUTTONS_REPEAT_AFTER;
+    buttons.debounce_timer = BUTTONS_DEBOUNCE_TIME;  // ignore bounces
+}
+
+
+// called from pin change interrupts; samples buttons
+// immediately unless waiting for contacts to settle
+void buttons_pcint(void) {
+    if(!buttons.debounce_timer) buttons_sample();
+}
+
+
+// resample buttons after debouncing and repeat held buttons
+void buttons_semitick(void) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	// resample after debounce time, since edges were ignored
+	if(buttons.debounce_timer && !--buttons.debounce_timer) {
+	    buttons_sample();
+	}
+
+	// report pending press when the chord time expires
+	if(buttons.chord_timer && !--buttons.chord_timer) {
+	    buttons_push(BUTTONS_PRESS | buttons.pressed);
+	}
+
+	// periodically repeat held buttons
+	if(buttons.pressed && !--buttons.repeat_timer) {
+	    buttons_push(BUTTONS_REPEAT | buttons.pressed);
+	    buttons.repeat_timer = BUTTONS_REPEAT_RATE;
+	}
+    }
+}
+
+
+// remove and return the oldest button event; zero if no events pending
+uint8_t buttons_event(void) {
+    uint8_t event = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	if(buttons.queue_tail != buttons.queue_head) {
+	    event = buttons.queue[buttons.queue_tail];
+	    ++buttons.queue_tail;
+	    buttons.queue_tail &= BUTTONS_QUEUE_SIZE - 1;
+	}
+    }
+
+    return event;
+}
+
+
+// discard pending events while they cannot be processed (e.g., during
+// display transitions), keeping only the latest press, chord, or
+// repeat while its buttons are held, so events do not replay later
+void buttons_coalesce(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	uint8_t latest = 0;
+
+	while(buttons.queue_tail != buttons.queue_head) {
+	    uint8_t event = buttons.queue[buttons.queue_tail];
+	    if(!(event & BUTTONS_RELEASE)) latest = event;
+	    ++buttons.queue_tail;
+	    buttons.queue_tail &= BUTTONS_QUEUE_SIZE - 1;
+	}
+
+	if(latest & buttons.pressed & BUTTONS_MASK) buttons_push(latest);
     }
 }
 
 
-// process a button press: if a button is pressed and not
-// previously processed, return it.  otherwise return zero.
+// process a button press: if a press, chord, or repeat event is
+// pending, return the pressed buttons.  otherwise return zero.
 uint8_t buttons_process(void) {
-    // return nothing if there is no button pressed
-    // or if any buttons pressed have already been processed
-    if(buttons.state & BUTTONS_PROCESSED || !buttons.pressed) return 0;
+    uint8_t event;
 
-    // mark this button press as processed
-    buttons.state |= BUTTONS_PROCESSED;
+    // skip release events
+    do {
+	event = buttons_event();
+	if(!event) return 0;
+    } while(event & BUTTONS_RELEASE);
 
     // make a nice, satisfying click with processed button press
     piezo_click();
 
     // return the pressed buttons
-    return buttons.pressed;
+    return event & BUTTONS_MASK;
 }
@@ -9,22 +9,42 @@
 
 // debounce and repeat settings
 #define BUTTONS_DEBOUNCE_TIME   30
+#define BUTTONS_CHORD_TIME      60  // must exceed BUTTONS_DEBOUNCE_TIME
 #define BUTTONS_REPEAT_AFTER  1000
 #define BUTTONS_REPEAT_RATE    100
 
-// button flags (for button.state and button.pressed)
+// button event queue length (must be a power of two)
+#define BUTTONS_QUEUE_SIZE 8
+
+// button flags (for button.pressed and button events)
 #define BUTTONS_MENU      0x01
 #define BUTTONS_SET       0x02
 #define BUTTONS_PLUS      0x04
+#define BUTTONS_MASK      0x0F
 
-// state flags (for button.state)
-#define BUTTONS_PROCESSED 0x10
-#define BUTTONS_REPEATING 0x20
+// event types; press, chord, and repeat events carry all pressed
+// buttons while release events carry only the released buttons.
+// a press is reported at once unless buttons.chord_hold is set; then
+// it is reported after BUTTONS_CHORD_TIME, or on release if sooner,
+// so buttons pressed together are reported as one press
+#define BUTTONS_PRESS     0x10  // buttons pressed while none were
+#define BUTTONS_CHORD     0x20  // button pressed while others held
+#define BUTTONS_REPEAT    0x40  // buttons held for repeat interval
+#define BUTTONS_RELEASE   0x80  // buttons released
 
 
 typedef struct {
-    uint8_t  state;  // sensed buttons and state
-    uint8_t pressed; // debounced button presses
+    uint8_t pressed;          // debounced button presses
+    uint8_t debounce_timer;   // semiseconds until buttons are resampled;
+    			      // zero when awaiting a pin change
+    uint16_t repeat_timer;    // semiseconds until next repeat event
+    uint8_t chord_hold;       // nonzero to hold presses for chords
+    uint8_t chord_timer;      // semiseconds until press is reported;
+    			      // zero when no press is pending
+
+    uint8_t queue[BUTTONS_QUEUE_SIZE];  // pending button events
+    uint8_t queue_head;       // index for next queued event
+    uint8_t queue_tail;       // index of oldest queued event
 } buttons_t;
 
 
@@ -37,7 +57,10 @@ void buttons_wake(void);
 
 static inline void buttons_tick(void) {};
 void buttons_semitick(void);
+void buttons_pcint(void);
 
+uint8_t buttons_event(void);
 uint8_t buttons_process(void);
+void buttons_coalesce(void);
 
 #endif
@@ -57,6 +57,27 @@
 #define LOW_BATTERY_VOLTAGE 2600  // millivolts
 
 
+// BATTERY FUEL GAUGE
+//
+// Defining the following macro enables a backup battery fuel gauge.
+// Battery voltage is then measured every six hours during sleep, and
+// each measurement is logged to a short eeprom history along with the
+// total time spent on battery power.  Remaining capacity and days of
+// backup are estimated from total time on battery, the rated battery
+// capacity, and the typical sleep current below; the estimate is
+// reduced if measured voltage nears the low battery threshold.
+//
+// The estimates are shown in the "battery" menu.  If the usart is
+// enabled (DEBUG or GPS_TIMEKEEPING), the voltage history is also
+// printed to the serial port when the menu is entered.  After
+// replacing the battery, reset the gauge from the same menu.
+//
+//
+// #define BATTERY_GAUGE
+// #define BATTERY_CAPACITY      225  // milliamp hours (CR2032)
+// #define BATTERY_SLEEP_CURRENT 10   // microamps
+
+
 // AUTOMATIC DIMMER HACK
 //
 // Defining the following macro enables support for Automatic dimming.
@@ -98,9 +119,31 @@
 // syncronize the clock time with the GPS time.  To disable the GPS
 // lost error message, comment out the GPS_LOST_ERROR_MSG macro below.
 //
+// By default, the clock parses the NMEA RMC sentence, which is about
+// 70 characters long and ties up the serial receiver for about 70 ms
+// each second.  If the GPS is a u-blox receiver, defining the
+// GPS_UBX_PROTOCOL macro below will instead configure the receiver to
+// disable all standard NMEA sentences and send only the 28-byte
+// binary UBX NAV-TIMEUTC message.  The clock will then parse the
+// binary message and verify its Fletcher checksum.  Other receivers,
+// such as the Adafruit Ultimate GPS, do not understand UBX, so leave
+// this macro undefined for those receivers.
+//
+// Once the clock agrees with the GPS for several consecutive seconds,
+// defining the GPS_DUTY_CYCLE macro below will cause the clock to
+// stop listening to the GPS for a while.  The clock resumes reception
+// after a short interval, and the first fix then measures how far the
+// clock drifted during the interval.  The next interval is as long as
+// the clock takes to drift by 1/4 second at that rate, but at most
+// twice the last.  So clocks with accurate drift correction will rarely
+// process GPS data.  If GPS_UBX_PROTOCOL is also defined, the receiver
+// is told to stop sending data during the interval.
+//
 //
 #define GPS_TIMEKEEPING
 #define GPS_LOST_ERROR_MSG
+// #define GPS_UBX_PROTOCOL
+// #define GPS_DUTY_CYCLE
 
 
 // USART BAUD RATE
@@ -140,6 +183,15 @@
 // The DQ lead should be connected to the PC1 pin on the ATmega328p and
 // to PC5 via a 4.7k pull-up resistor.
 //
+// Up to four DS18B20 sensors may share the PC1 bus, for example, one
+// by the crystal and another outside the case for room temperature.
+// All sensors measure temperature simultaneously and are then read in
+// turn.  XTAL_SENSOR selects the sensor by the crystal by its position
+// in 1-Wire ROM search order, which is fixed for a given set of
+// sensors; the first other sensor provides the displayed temperature.
+// With debugging output enabled, the order can be found by warming one
+// sensor and watching temp.temps[] on the serial port.
+//
 // The XTAL_TURNOVER_TEMP macro specifies the temperature at which the
 // crystal oscillates at maximum frequency in units of deg C / 16.
 // The XTAL_FREQUENCY_COEF macro specifies the parabolic temperature
@@ -149,6 +201,33 @@
 // (25 * 16), and XTAL_FREQUENCY_COEF should be defined as 34
 // (-0.034 * -1000).
 //
+// If GPS_TIMEKEEPING is also enabled, defining XTAL_LEARN_CURVE will
+// allow the clock to learn the temperature dependence of its own
+// crystal.  Whenever the temperature remains steady for a couple
+// hours, the clock compares its time against the GPS time and refines
+// a table of frequency errors in 2 deg C steps from 0 to 62 deg C.
+// Until learned, table entries are calculated from XTAL_TURNOVER_TEMP
+// and XTAL_FREQUENCY_COEF.
+//
+// Clocks without a DS18B20 can instead use the temperature sensor
+// inside the ATmega328P by defining TEMPERATURE_INTERNAL along with
+// the macros below.  This requires a hardware modification.  The
+// sensor must be measured against the internal 1.1 volt reference,
+// which the microcontroller drives onto the AREF pin, but AREF is
+// wired to the 5 volt supply on the stock board.  Disconnect AREF from
+// the supply, leaving at most a 100 nF capacitor from AREF to ground,
+// and define AREF_ISOLATED; the photoresistor and battery are then
+// measured against AVCC.  Enabling the internal reference on an
+// unmodified board would short it against the supply, so defining
+// TEMPERATURE_INTERNAL without AREF_ISOLATED is a build error.  About
+// once a second, photoresistor readings pause for about 130 ms while
+// the sensor is sampled, and readings are averaged over 16 seconds.
+// TEMPERATURE_INTERNAL_OFFSET is the sensor voltage
+// in mV at 0 deg C, which varies between chips by 10 deg C or more;
+// subtract the true temperature from the reported temperature (with
+// debugging output enabled) and add the result to the default.  If
+// XTAL_LEARN_CURVE is defined, a wrong offset is learned around.
+//
 // The technique for software temperature compensation is described in
 // the following thread:
 //
@@ -165,6 +244,11 @@
 // #define TEMPERATURE_SENSOR
 // #define XTAL_TURNOVER_TEMP  400  // deg C / 16
 // #define XTAL_FREQUENCY_COEF 34   // -ppb / (deg C)^2
+// #define XTAL_SENSOR         0    // index of crystal sensor
+// #define TEMPERATURE_INTERNAL
+// #define TEMPERATURE_INTERNAL_OFFSET 289  // mV at 0 deg C
+// #define AREF_ISOLATED  // only after the hardware modification
+// #define XTAL_LEARN_CURVE
 
 
 // BIRTHDAY ALARM
@@ -421,6 +505,21 @@
 #endif
 
 
+// TICKLESS SLEEP
+//
+// During sleep, the clock normally wakes once per second to keep time.
+// The following macro lets the clock sleep for up to seven seconds at
+// a time, waking early only when an alarm, snooze, or battery check is
+// due, and then catching up on the elapsed seconds all at once.  Fewer
+// wakeups extend battery life, but the clock may take several seconds
+// to notice that external power has been restored.  Drift corrections
+// during sleep are applied in 1/32 second steps, with the remainder
+// carried forward, so long-term accuracy is unaffected.
+//
+//
+// #define TICKLESS_SLEEP
+
+
 // DEBUGGING FEATURES
 //
 // The following macro enables debugging.  When enabled, debugging
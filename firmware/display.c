@@ -16,7 +16,8 @@
 //
 //   * PC5 is used to directly power the photoresistor, vfd power, and
 //     temperature sensor pull-up if configured for the xmas-icetube
-//     hardware design.
+//     hardware design.  Otherwise, unless a DS18B20 pull-up is attached,
+//     PC5 powers the photoresistor only while it is sampled.
 //
 //  ** PD5--not PC3--is used to control the BLANK pin if and only if
 //     the IV-18 to-spec hack is enabled.
@@ -39,6 +40,7 @@
 #include "usart.h"    // for debugging output
 #include "system.h"   // for determining system status
 #include "time.h"     // for determing current time
+#include "temp.h"     // for sampling internal temperature sensor
 
 
 // extern'ed data pertaining the display
@@ -360,13 +362,19 @@ void display_init(void) {
 #endif  // VFD_TO_SPEC
 
 #ifdef AUTOMATIC_DIMMER
-    // set initial photo_avg to maximum ambient light
+    // set initial photo_avg to minimum ambient light
     display.photo_avg = UINT16_MAX;
+    display.photo_sample = DISPLAY_PHOTO_NONE;
 
     // load the display-off threshold
     display_loadphotooff();
 #endif  // AUTOMATIC_DIMMER
 
+#if defined(TEMPERATURE_SENSOR) && defined(TEMPERATURE_INTERNAL)
+    // begin a temperature sensor window when first possible
+    display.temp_timer = TEMP_INTERNAL_PERIOD;
+#endif  // TEMPERATURE_SENSOR && TEMPERATURE_INTERNAL
+
     // load the digit display times
 #ifndef SEGMENT_MULTIPLEXING
     display_loaddigittimes();
@@ -407,22 +415,24 @@ uint8_t display_onbutton(void) {
 
 // enable display after low-power mode
 void display_wake(void) {
+#if !defined(DISPLAY_PHOTO_SWITCHED) || defined(AUTOMATIC_DIMMER)
     // enable external and internal photoresistor pull-ups (the latter
     // ensures a defined value if no photoresistor installed)
     PORTC |= _BV(PC5) | _BV(PC4);  // output +5v, enable pull-up
+#endif  // ~DISPLAY_PHOTO_SWITCHED || AUTOMATIC_DIMMER
 
     // enable analog to digital converter
     power_adc_enable();
 
     // select ADC4 as analog to digital input
     //   MUX3:0 = 0100:  ADC4 as input
-    ADMUX = _BV(MUX2);
+    ADMUX = SYSTEM_ADC_REF | _BV(MUX2);
 
     // configure analog to digital converter
     // ADEN    =   1:  enable analog to digital converter
-    // ADSC    =   1:  start ADC conversion now
+    // ADIE    =   1:  interrupt on conversion complete
     // ADPS2:0 = 110:  system clock / 64  (8 MHz / 4 = 125 kHz)
-    ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADPS2) | _BV(ADPS1);
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1);
 
     // configure spi sck and mosi pins as outputs
     DDRB |= _BV(PB5) | _BV(PB3);
@@ -487,6 +497,17 @@ void display_sleep(void) {
     ADCSRA = 0;  // disable ADC before power_adc_disable()
     power_adc_disable();
 
+#ifdef AUTOMATIC_DIMMER
+    // abandon any photoresistor burst in progress
+    display.photo_count  = 0;
+    display.photo_sample = DISPLAY_PHOTO_NONE;
+#endif  // AUTOMATIC_DIMMER
+
+#if defined(TEMPERATURE_SENSOR) && defined(TEMPERATURE_INTERNAL)
+    // abandon any temperature sensor window in progress
+    display.temp_timer = TEMP_INTERNAL_PERIOD;
+#endif  // TEMPERATURE_SENSOR && TEMPERATURE_INTERNAL
+
 #ifdef VFD_TO_SPEC
     // configure MAX6921 LOAD and BLANK pins
     PORTC &= ~_BV(PC0); // clamp to ground
@@ -1225,6 +1246,49 @@ uint8_t display_varsemitick(void) {
 #endif  // SEGMENT_MULTIPLEXING
 
 
+#if defined(TEMPERATURE_SENSOR) && defined(TEMPERATURE_INTERNAL)
+// utility function for display_semitick(); samples the internal
+// temperature sensor in a window every TEMP_INTERNAL_PERIOD semiseconds,
+// beginning when the adc is free.  conversions are used only after
+// AREF settles to the 1.1 volt reference, and the window holds the adc
+// until AREF settles back to AVCC (see temp.h).  returns nonzero while
+// the window holds the adc.
+static uint8_t display_temp_semitick(uint8_t adc_free) {
+    if(display.temp_timer >= TEMP_INTERNAL_PERIOD) {
+	if(!adc_free) return 0;
+
+	// select ADC8 (temperature sensor) as input
+	//   REFS1:0 =   11:  internal 1.1v reference, as the sensor requires
+	//   MUX3:0  = 1000:  ADC8 as input
+	ADMUX = _BV(REFS1) | _BV(REFS0) | _BV(MUX3);
+	display.temp_timer = 0;
+	return 1;
+    }
+
+    uint16_t t = ++display.temp_timer;
+
+    // the conversion started at TEMP_INTERNAL_SETTLE - 1 is the first
+    // after switching references, so it is discarded
+    if(t > TEMP_INTERNAL_SETTLE
+	    && t <= TEMP_INTERNAL_SETTLE + TEMP_INTERNAL_SAMPLES) {
+	temp_adc(ADC);
+    }
+
+    if(t >= TEMP_INTERNAL_SETTLE - 1
+	    && t < TEMP_INTERNAL_SETTLE + TEMP_INTERNAL_SAMPLES) {
+	ADCSRA |= _BV(ADSC);  // begin next conversion
+    }
+
+    // select ADC4 (photoresistor) against AVCC again
+    if(t == TEMP_INTERNAL_SETTLE + TEMP_INTERNAL_SAMPLES) {
+	ADMUX = SYSTEM_ADC_REF | _BV(MUX2);
+    }
+
+    return t < TEMP_INTERNAL_WINDOW;
+}
+#endif  // TEMPERATURE_SENSOR && TEMPERATURE_INTERNAL
+
+
 // called every semisecond; updates ambient brightness running average
 void display_semitick(void) {
     // Update the display transition variables as time passes:
@@ -1274,23 +1338,67 @@ void display_semitick(void) {
     // the running average has a range of [0, 0xFFFF]
     static uint8_t photo_timer = DISPLAY_ADC_DELAY;
 
-    if(!--photo_timer) {
+#if defined(TEMPERATURE_SENSOR) && defined(TEMPERATURE_INTERNAL)
+    // hold photoresistor samples while the temperature sensor has the
+    // adc; a sensor window begins only after a completed burst
+    uint8_t photo_held = display_temp_semitick(photo_timer
+					       == DISPLAY_ADC_DELAY);
+#else
+    const uint8_t photo_held = 0;
+#endif  // TEMPERATURE_SENSOR && TEMPERATURE_INTERNAL
+
+    if(!photo_held && !--photo_timer) {
 	// repeat in 16 semiseconds
         photo_timer = DISPLAY_ADC_DELAY;
 
-	// update adc running average (display.photo_avg)
-	display.photo_avg -= (display.photo_avg >> 6);
-	display.photo_avg += ADC;
+	// update adc running average (display.photo_avg) from the
+	// completed burst; the sample is scaled to [0, 0xFFFF]
+	if(!display.photo_count && display.photo_sample != DISPLAY_PHOTO_NONE) {
+	    uint16_t sample = display.photo_sample
+			      << (6 - DISPLAY_PHOTO_DECIMATE);
+	    display.photo_sample = DISPLAY_PHOTO_NONE;
+
+	    if(sample < display.photo_avg) {
+		display.photo_avg -= (display.photo_avg - sample)
+				     >> DISPLAY_PHOTO_ATTACK;
+	    } else {
+		display.photo_avg += (sample - display.photo_avg)
+				     >> DISPLAY_PHOTO_DECAY;
+	    }
+	}
 
-        // begin next analog to digital conversion
-        ADCSRA |= _BV(ADSC);
+#ifdef DISPLAY_PHOTO_SWITCHED
+	// disable photoresistor pull-ups until next sample
+	PORTC &= ~_BV(PC5) & ~_BV(PC4);
+#endif  // DISPLAY_PHOTO_SWITCHED
 
 	// update brightness from display.photo_avg if not pulsing
 	if(!(display.status & DISPLAY_PULSING)) display_autodim();
     }
+
+#ifdef DISPLAY_PHOTO_SWITCHED
+    // enable photoresistor pull-ups a semisecond before the
+    // photoresistor voltage conversions to let the voltage settle
+    if(photo_timer == DISPLAY_PHOTO_BURST + 1) PORTC |= _BV(PC5) | _BV(PC4);
+#endif  // DISPLAY_PHOTO_SWITCHED
+
+    // begin burst of photoresistor voltage conversions; subsequent
+    // conversions are started from the adc interrupt
+    if(photo_timer == DISPLAY_PHOTO_BURST) {
+	display.photo_sum   = 0;
+	display.photo_count = DISPLAY_PHOTO_SAMPLES + 1;
+	ADCSRA |= _BV(ADSC);
+    }
 #endif  // AUTOMATIC_DIMMER
 
 
+#if defined(TEMPERATURE_SENSOR) && defined(TEMPERATURE_INTERNAL) \
+    && !defined(AUTOMATIC_DIMMER)
+    // without photoresistor bursts, the adc is always free
+    display_temp_semitick(1);
+#endif  // TEMPERATURE_SENSOR && TEMPERATURE_INTERNAL && ~AUTOMATIC_DIMMER
+
+
     // update display brightness if pulsing
     if(display.status & DISPLAY_PULSING) {
 	static uint8_t pulse_timer = DISPLAY_PULSE_DELAY;
@@ -1656,9 +1764,23 @@ void display_saveondays(void) {
 // set display brightness using photoresistor or specified level
 void display_autodim(void) {
 #ifdef AUTOMATIC_DIMMER
-    // convert photoresistor value to [0-80] for display_setbrightness()
-    int16_t grad_idx = (display.bright_max << 3) - (((display.photo_avg >> 8)
-		      * (display.bright_max - display.bright_min)) >> 5);
+    // rebuild the multiples of the brightness range if it changed
+    int8_t span = display.bright_max - display.bright_min;
+    if(span != display.photo_span) {
+	int16_t multiple = 0;
+	for(uint8_t i = 0; i < 16; ++i) {
+	    display.photo_scale[i] = multiple;
+	    multiple += span;
+	}
+	display.photo_span = span;
+    }
+
+    // convert photoresistor value to [0-80] for display_setbrightness();
+    // dark * span is looked up from the high and low nibbles of dark
+    uint8_t dark = display.photo_avg >> 8;
+    int16_t grad_idx = (display.bright_max << 3)
+		     - (((display.photo_scale[dark >> 4] << 4)
+			 + display.photo_scale[dark & 0x0F]) >> 5);
 
     // add a 1-index lag to grad_idx to prevent
     // rapid cycling between brightness levels
@@ -5,8 +5,6 @@
 #include <avr/pgmspace.h>  // for accessing data in program memory
 
 #include "config.h"  // for configuration macros
-#include "temp.h"    // to compensate for timing errors
-		     // while determining temperature
 
 
 #define DISPLAY_SIZE 9
@@ -43,6 +41,25 @@
 // time between photoresister voltage samples
 #define DISPLAY_ADC_DELAY 16  // (semiticks)
 
+// each photoresistor sample is a burst of conversions chained from the
+// adc interrupt; 16x oversampling yields two additional bits of resolution
+#define DISPLAY_PHOTO_SAMPLES  16  // conversions per burst
+#define DISPLAY_PHOTO_DECIMATE 2   // additional bits from oversampling
+#define DISPLAY_PHOTO_BURST    3   // semiticks before sample is needed
+#define DISPLAY_PHOTO_NONE     UINT16_MAX  // no sample available
+
+// photo_avg follows samples quickly as lighting brightens,
+// but slowly as lighting dims (right-shift of difference)
+#define DISPLAY_PHOTO_ATTACK 2
+#define DISPLAY_PHOTO_DECAY  6
+
+// unless PC5 also powers the MAX6921 (xmas design) or the DS18B20 pull-up,
+// the photoresistor divider is powered only around each sample
+#if !defined(XMAS_DESIGN) \
+    && (!defined(TEMPERATURE_SENSOR) || defined(TEMPERATURE_INTERNAL))
+#define DISPLAY_PHOTO_SWITCHED
+#endif
+
 // disabled flag for display.off_hour
 #define DISPLAY_NOOFF 0x80
 
@@ -99,13 +116,30 @@ typedef struct {
     // photoresistor adc result (times 2^6, running average)
     uint16_t photo_avg;
 
+    // photoresistor conversion burst: conversions remaining,
+    // running sum, and decimated result (or DISPLAY_PHOTO_NONE)
+    uint8_t  photo_count;
+    uint16_t photo_sum;
+    uint16_t photo_sample;
+
     // current brightness level from photoresistor
     // (truncated to [0, 80] for actual display brightness)
     int16_t photo_idx;
+
+    // multiples 0 to 15 of photo_span (bright_max - bright_min);
+    // display_autodim() scales the photoresistor value by photo_span
+    // with two lookups rather than a multiply
+    int8_t  photo_span;
+    int16_t photo_scale[16];
 #else
     int8_t  brightness;             // display brightness
 #endif  // AUTOMATIC_DIMMER
 
+#if defined(TEMPERATURE_SENSOR) && defined(TEMPERATURE_INTERNAL)
+    // semiseconds since the last temperature sensor window began
+    uint16_t temp_timer;
+#endif  // TEMPERATURE_SENSOR && TEMPERATURE_INTERNAL
+
     // off time:  disable display after off_hour and off_minute;
     //            enable display after on_hour and on_minute
     // off time is disabled when the highest bit, DISPLAY_NOOFF, is set
@@ -156,20 +190,29 @@ void display_on(void);
 uint8_t display_varsemitick(void);
 void display_semitick(void);
 
+// called from the adc conversion complete interrupt
+static inline void display_adc(void) {
+#ifdef AUTOMATIC_DIMMER
+    // ignore conversions outside photoresistor bursts
+    if(!display.photo_count) return;
+
+    // the first conversion after switching inputs is discarded
+    if(display.photo_count <= DISPLAY_PHOTO_SAMPLES) display.photo_sum += ADC;
+
+    if(--display.photo_count) {
+	ADCSRA |= _BV(ADSC);  // begin next conversion
+    } else {
+	display.photo_sample = display.photo_sum >> DISPLAY_PHOTO_DECIMATE;
+    }
+#endif  // AUTOMATIC_DIMMER
+}
+
 // toggle push-pull outputs to generate alternating current on vfd fillament
 static inline void display_semisemitick(void) {
     // multiplex the display
     if(display.multiplex_div && !--display.multiplex_div) {
 	display.multiplex_div = display_varsemitick();
     }
-#ifdef TEMPERATURE_SENSOR
-    while(temp.missed_ovf) {
-	--temp.missed_ovf;
-	if(display.multiplex_div && !--display.multiplex_div) {
-	    display.multiplex_div = display_varsemitick();
-	}
-    }
-#endif  // TEMPERATURE_SENSOR
 
     // generate ac-filament current as required
 #if defined(VFD_TO_SPEC)
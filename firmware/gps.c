@@ -10,12 +10,14 @@
 #include <avr/eeprom.h>     // for accessing data in eeprom memory
 #include <avr/interrupt.h>  // for defining usart rx interrupt
 #include <util/atomic.h>    // for non-interruptable blocks
+#include <avr/pgmspace.h>   // for ubx configuration in program memory
 
 #include "gps.h"
 #include "time.h"
 #include "usart.h"
 #include "alarm.h"
 #include "mode.h"
+#include "temp.h"
 
 
 #define FIELD_RECORD_START                  0
@@ -35,6 +37,38 @@
 #define FIELD_CHECKSUM                     14
 #define FIELD_NEWLINE                      15
 
+#ifdef GPS_UBX_PROTOCOL
+#define FIELD_UBX_SYNC1   0
+#define FIELD_UBX_SYNC2   1
+#define FIELD_UBX_CLASS   2
+#define FIELD_UBX_ID      3
+#define FIELD_UBX_LENGTH  4
+#define FIELD_UBX_PAYLOAD 5
+#define FIELD_UBX_CK_A    6
+#define FIELD_UBX_CK_B    7
+
+
+// cfg-msg payloads (message class, message id, rate) sent on wake:
+// disable the standard nmea sentences and send nav-timeutc every second
+const uint8_t gps_ubx_cfg_msg[][3] PROGMEM = {
+    {GPS_UBX_CLASS_NMEA, 0x00, 0},  // gga
+    {GPS_UBX_CLASS_NMEA, 0x01, 0},  // gll
+    {GPS_UBX_CLASS_NMEA, 0x02, 0},  // gsa
+    {GPS_UBX_CLASS_NMEA, 0x03, 0},  // gsv
+    {GPS_UBX_CLASS_NMEA, 0x04, 0},  // rmc
+    {GPS_UBX_CLASS_NMEA, 0x05, 0},  // vtg
+    {GPS_UBX_CLASS_NAV,  GPS_UBX_ID_TIMEUTC, 1},  // nav-timeutc
+};
+
+#ifdef GPS_DUTY_CYCLE
+// cfg-msg payloads to stop and restart nav-timeutc output
+const uint8_t gps_ubx_timeutc_off[] PROGMEM = {
+    GPS_UBX_CLASS_NAV, GPS_UBX_ID_TIMEUTC, 0};
+const uint8_t gps_ubx_timeutc_on[]  PROGMEM = {
+    GPS_UBX_CLASS_NAV, GPS_UBX_ID_TIMEUTC, 1};
+#endif  // GPS_DUTY_CYCLE
+#endif  // GPS_UBX_PROTOCOL
+
 
 // extern'ed gps data
 volatile gps_t gps;
@@ -48,6 +82,10 @@ uint8_t ee_gps_rel_utc_minute EEMEM = TIME_DEFAULT_UTC_OFFSET_MINUTES;
 // load time offsets from gmt/utc
 void gps_init(void) {
     gps_loadrelutc();
+
+#ifdef GPS_DUTY_CYCLE
+    gps.sleep_interval = GPS_SLEEP_MIN;
+#endif  // GPS_DUTY_CYCLE
 }
 
 
@@ -64,6 +102,28 @@ void gps_wake(void) {
 
     // gps needs to reacquire satellites
     gps.status &= ~GPS_SIGNAL_GOOD;
+
+#ifdef GPS_DUTY_CYCLE
+    // receive gps data until clock is synchronized; drift while
+    // the clock slept is unknown, so it cannot be measured
+    gps.sleep_timer   = 0;
+    gps.lock_count    = 0;
+    gps.sleep_measure = FALSE;
+#ifdef GPS_UBX_PROTOCOL
+    gps.ubx_pending   = 0;  // receiver is reconfigured below
+#endif  // GPS_UBX_PROTOCOL
+#endif  // GPS_DUTY_CYCLE
+
+#ifdef GPS_UBX_PROTOCOL
+    // search for start of ubx frame
+    gps.field = FIELD_UBX_SYNC1;
+
+    // switch receiver from nmea to ubx nav-timeutc
+    for(uint8_t i = 0; i < sizeof(gps_ubx_cfg_msg) / 3; ++i) {
+	gps_ubx_send(GPS_UBX_CLASS_CFG, GPS_UBX_ID_CFG_MSG,
+		     gps_ubx_cfg_msg[i], sizeof(gps_ubx_cfg_msg[i]));
+    }
+#endif  // GPS_UBX_PROTOCOL
 }
 
 
@@ -74,8 +134,62 @@ void gps_sleep(void) {
 }
 
 
+#ifdef GPS_UBX_PROTOCOL
+// transmit ubx frame with payload from program memory
+void gps_ubx_send(uint8_t msg_class, uint8_t msg_id,
+		  const uint8_t *payload, uint8_t length) {
+    uint8_t ck_a = 0, ck_b = 0;
+
+    usart_putc(GPS_UBX_SYNC1);
+    usart_putc(GPS_UBX_SYNC2);
+
+    // class, id, little-endian length, then payload
+    for(int8_t i = -4; i < length; ++i) {
+	uint8_t c;
+
+	switch(i) {
+	    case -4:
+		c = msg_class;
+		break;
+	    case -3:
+		c = msg_id;
+		break;
+	    case -2:
+		c = length;
+		break;
+	    case -1:
+		c = 0;
+		break;
+	    default:
+		c = pgm_read_byte(&(payload[i]));
+		break;
+	}
+
+	// 8-bit fletcher checksum
+	ck_a += c;
+	ck_b += ck_a;
+
+	usart_putc(c);
+    }
+
+    usart_putc(ck_a);
+    usart_putc(ck_b);
+}
+#endif  // GPS_UBX_PROTOCOL
+
+
 // decrement gps timers
 void gps_tick(void) {
+#ifdef GPS_DUTY_CYCLE
+    if(gps.sleep_timer) {
+	// gps timers are frozen while reception is suspended
+	if(!--gps.sleep_timer) gps_resume();
+	return;
+    }
+
+    if(gps.lock_count >= GPS_LOCK_FIXES) gps_suspend();
+#endif  // GPS_DUTY_CYCLE
+
     if(gps.data_timer) {
 	--gps.data_timer;
     } else {
@@ -125,9 +239,6 @@ void gps_settime(void) {
 	    return;
 	}
 
-	// never set time when new time could skip alarm time
-	if(alarm_nearalarm()) return;
-
 	// first, convert time to local time
 	int8_t second = gps.second;
 	int8_t minute = gps.minute + gps.rel_utc_minute;
@@ -188,13 +299,52 @@ void gps_settime(void) {
 	    time_diff += (int32_t)24 * 60 * 60;
 	}
 
+#ifdef GPS_DUTY_CYCLE
+	// the first fix after reception resumes measures the clock
+	// drift while suspended, which sets the next suspend interval
+	int32_t offset = (int32_t)TCNT2 - (time_diff << 7);
+	if(gps.sleep_measure) {
+	    gps.sleep_measure = FALSE;
+	    gps_interval(offset - gps.sleep_offset);
+	}
+	gps.sleep_offset = offset;
+#endif  // GPS_DUTY_CYCLE
+
 	if(time_diff && time_diff != 1) {
-	    // note: this code will never be called if near an alarm
-	    // time, so we don't have to worry about missing an alarm
-	    // by skipping forward over it
-	    time_settime(hour, minute, second);
-	    mode_tick();  // refresh display to show new time
+	    // wait for any previous correction to finish slewing
+	    if(time.slew_adjust) return;
+
+#ifdef XTAL_LEARN_CURVE
+	    // time will change, so clock and gps cannot be compared
+	    temp_learn_reset();
+#endif  // XTAL_LEARN_CURVE
+
+	    if(-TIME_SLEW_MAX <= time_diff && time_diff <= TIME_SLEW_MAX) {
+		// gradually correct small differences, so the displayed
+		// time never jumps and no alarm time can be skipped
+		time_slewtime(time_diff);
+	    } else {
+		// never set time when new time could skip alarm time
+		if(alarm_nearalarm()) return;
+
+		time_settime(hour, minute, second);
+		mode_tick();  // refresh display to show new time
+	    }
+
+#ifdef GPS_DUTY_CYCLE
+	    // clock disagrees, so keep receiving until it agrees again
+	    gps.lock_count = 0;
+	} else {
+	    if(gps.lock_count < GPS_LOCK_FIXES) ++gps.lock_count;
+#endif  // GPS_DUTY_CYCLE
+	}
+
+#ifdef XTAL_LEARN_CURVE
+	if(time_diff == 0 || time_diff == 1) {
+	    // compare clock and gps time, including fractional seconds
+	    temp_learn((int32_t)TCNT2 - (time_diff << 7));
 	}
+#endif  // XTAL_LEARN_CURVE
 
 	// ensure date is correct for new time
         // if date is incorrect and time is not near midnight
@@ -208,6 +358,197 @@ void gps_settime(void) {
 }
 
 
+#ifdef GPS_DUTY_CYCLE
+// set the suspend interval from the clock drift (1/128 seconds) over
+// the previous interval:  the clock may drift by GPS_SLEEP_ERROR before
+// reception resumes, and the interval at most doubles, because a
+// short interval measures the drift rate only roughly
+void gps_interval(int32_t drift) {
+    if(drift < 0) drift = -drift;
+
+    uint32_t interval = (uint32_t)gps.sleep_interval * GPS_SLEEP_ERROR
+			/ ((uint32_t)drift + GPS_SLEEP_JITTER);
+
+    if(interval > (uint32_t)gps.sleep_interval << 1) {
+	interval = (uint32_t)gps.sleep_interval << 1;
+    }
+
+    if(interval < GPS_SLEEP_MIN) interval = GPS_SLEEP_MIN;
+    if(interval > GPS_SLEEP_MAX) interval = GPS_SLEEP_MAX;
+
+    gps.sleep_interval = interval;
+}
+
+
+// stop processing gps data while clock is synchronized
+void gps_suspend(void) {
+    gps.sleep_timer = gps.sleep_interval;
+    gps.lock_count  = 0;
+
+    // disable usart rx interrupt
+    UCSR0B &= ~_BV(RXCIE0);
+
+#ifdef GPS_UBX_PROTOCOL
+    // silence receiver output; called from the timer2 interrupt,
+    // so the frame is sent later by gps_idle()
+    gps.ubx_pending = GPS_UBX_PENDING_OFF;
+#endif  // GPS_UBX_PROTOCOL
+}
+
+
+// resume processing gps data after suspension
+void gps_resume(void) {
+    gps.sleep_timer   = 0;
+    gps.sleep_measure = TRUE;
+
+#ifdef GPS_UBX_PROTOCOL
+    // restart receiver output (sent by gps_idle())
+    // and search for start of ubx frame
+    gps.ubx_pending = GPS_UBX_PENDING_ON;
+    gps.field = FIELD_UBX_SYNC1;
+#else
+    // ignore partial rmc record until next carriage return
+    gps.status |= GPS_INVALID_RMC;
+#endif  // GPS_UBX_PROTOCOL
+
+    // enable usart rx interrupt
+    UCSR0B |= _BV(RXCIE0);
+}
+
+
+#ifdef GPS_UBX_PROTOCOL
+// send the receiver output change queued by gps_suspend() or
+// gps_resume(); called from the idle loop, so the blocking usart
+// transmission of the frame never delays other interrupts
+void gps_idle(void) {
+    uint8_t pending;
+
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	pending = gps.ubx_pending;
+	gps.ubx_pending = 0;
+    }
+
+    switch(pending) {
+	case GPS_UBX_PENDING_OFF:
+	    gps_ubx_send(GPS_UBX_CLASS_CFG, GPS_UBX_ID_CFG_MSG,
+			 gps_ubx_timeutc_off, sizeof(gps_ubx_timeutc_off));
+	    break;
+	case GPS_UBX_PENDING_ON:
+	    gps_ubx_send(GPS_UBX_CLASS_CFG, GPS_UBX_ID_CFG_MSG,
+			 gps_ubx_timeutc_on, sizeof(gps_ubx_timeutc_on));
+	    break;
+	default:
+	    break;
+    }
+}
+#endif  // GPS_UBX_PROTOCOL
+#endif  // GPS_DUTY_CYCLE
+
+
+#ifdef GPS_UBX_PROTOCOL
+// parse byte of ubx nav-timeutc frame from gps
+ISR(USART_RX_vect) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	uint8_t c = UDR0;
+
+	// checksum covers class, id, length, and payload
+	if(FIELD_UBX_CLASS <= gps.field && gps.field <= FIELD_UBX_PAYLOAD) {
+	    gps.checksum   += c;
+	    gps.checksum_b += gps.checksum;
+	}
+
+	switch(gps.field) {
+	    case FIELD_UBX_SYNC1:
+		if(c == GPS_UBX_SYNC1) gps.field = FIELD_UBX_SYNC2;
+		return;
+
+	    case FIELD_UBX_SYNC2:
+		if(c == GPS_UBX_SYNC2) {
+		    gps.field      = FIELD_UBX_CLASS;
+		    gps.checksum   = 0;
+		    gps.checksum_b = 0;
+		} else {
+		    gps.field = FIELD_UBX_SYNC1;
+		}
+		return;
+
+	    case FIELD_UBX_CLASS:
+		// only nav-timeutc frames are parsed; ignore all others
+		gps.field = (c == GPS_UBX_CLASS_NAV ? FIELD_UBX_ID
+						     : FIELD_UBX_SYNC1);
+		return;
+
+	    case FIELD_UBX_ID:
+		gps.field = (c == GPS_UBX_ID_TIMEUTC ? FIELD_UBX_LENGTH
+						      : FIELD_UBX_SYNC1);
+		gps.idx = 0;
+		return;
+
+	    case FIELD_UBX_LENGTH:
+		if(c != (gps.idx ? 0 : GPS_UBX_TIMEUTC_LEN)) {
+		    gps.field = FIELD_UBX_SYNC1;
+		} else if(gps.idx) {
+		    gps.field = FIELD_UBX_PAYLOAD;
+		    gps.idx   = 0;
+		} else {
+		    ++gps.idx;
+		}
+		return;
+
+	    case FIELD_UBX_PAYLOAD:
+		switch(gps.idx) {
+		    case 12:  // year (low byte)
+			gps.year = c;
+			break;
+		    case 13:  // year (high byte)
+			gps.year = ((c << 8) | (uint8_t)gps.year) - 2000;
+			break;
+		    case 14:
+			gps.month = c;
+			break;
+		    case 15:
+			gps.day = c;
+			break;
+		    case 16:
+			gps.hour = c;
+			break;
+		    case 17:
+			gps.minute = c;
+			break;
+		    case 18:
+			gps.second = c;
+			break;
+		    case 19:  // validity flags
+			gps.status_code = (c & GPS_UBX_VALID_UTC ? 'A' : 'V');
+			gps.field = FIELD_UBX_CK_A;
+			break;
+		    default:
+			break;
+		}
+		++gps.idx;
+		return;
+
+	    case FIELD_UBX_CK_A:
+		if(c != gps.checksum) gps.status |= GPS_INVALID_CHECKSUM;
+		gps.field = FIELD_UBX_CK_B;
+		return;
+
+	    case FIELD_UBX_CK_B:
+		if(c == gps.checksum_b && !(gps.status & GPS_INVALID_CHECKSUM)) {
+		    gps_settime();
+		}
+
+		gps.status &= GPS_SIGNAL_GOOD;
+		gps.field   = FIELD_UBX_SYNC1;
+		return;
+
+	    default:
+		gps.field = FIELD_UBX_SYNC1;
+		return;
+	}
+    }
+}
+#else  // GPS_UBX_PROTOCOL
 // parse character from gps
 ISR(USART_RX_vect) {
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
@@ -422,5 +763,6 @@ ISR(USART_RX_vect) {
 	++gps.idx;
     }
 }
+#endif  // GPS_UBX_PROTOCOL
 
 #endif  // GPS_TIMEKEEPING
@@ -16,6 +16,25 @@
 #define GPS_INVALID_CHECKSUM   0x20
 #define GPS_SIGNAL_GOOD        0x40
 
+#ifdef GPS_UBX_PROTOCOL
+// ubx frame sync characters
+#define GPS_UBX_SYNC1 0xB5
+#define GPS_UBX_SYNC2 0x62
+
+// ubx message classes and ids
+#define GPS_UBX_CLASS_NAV    0x01
+#define GPS_UBX_CLASS_CFG    0x06
+#define GPS_UBX_CLASS_NMEA   0xF0
+#define GPS_UBX_ID_TIMEUTC   0x21
+#define GPS_UBX_ID_CFG_MSG   0x01
+
+// length of nav-timeutc payload
+#define GPS_UBX_TIMEUTC_LEN  20
+
+// valid flags in nav-timeutc payload
+#define GPS_UBX_VALID_UTC    0x04
+#endif  // GPS_UBX_PROTOCOL
+
 // standard definitions for TRUE and FALSE
 #ifndef TRUE
 #define TRUE 1
@@ -30,6 +49,28 @@
 #define GPS_DATA_TIMEOUT  15  // (seconds)
 #define GPS_WARN_TIMEOUT 180  // (seconds)
 
+#ifdef GPS_DUTY_CYCLE
+// consecutive fixes agreeing with clock before suspending reception
+#define GPS_LOCK_FIXES    10
+
+// bounds for the reception suspend interval, gps.sleep_interval
+#define GPS_SLEEP_MIN     60  // (seconds)
+#define GPS_SLEEP_MAX   7680  // (seconds)
+
+// the suspend interval is set so the clock drifts at most
+// GPS_SLEEP_ERROR before reception resumes, at the drift rate measured
+// over the previous interval; GPS_SLEEP_JITTER allows for variation
+// in when rmc sentences arrive (both in 1/128 seconds)
+#define GPS_SLEEP_ERROR   32
+#define GPS_SLEEP_JITTER   2
+
+#ifdef GPS_UBX_PROTOCOL
+// receiver output changes queued for gps_idle(), gps.ubx_pending
+#define GPS_UBX_PENDING_OFF 1  // stop nav-timeutc output
+#define GPS_UBX_PENDING_ON  2  // restart nav-timeutc output
+#endif  // GPS_UBX_PROTOCOL
+#endif  // GPS_DUTY_CYCLE
+
 // the maximum and minimum hour offset from utc/gmt
 #define GPS_HOUR_OFFSET_MIN -12
 #define GPS_HOUR_OFFSET_MAX  14
@@ -37,8 +78,11 @@
 
 typedef struct {
     uint8_t status;    // rmc parse status flags
-    uint8_t checksum;  // rmc checksum
-    uint8_t field;     // current rmc field
+    uint8_t checksum;  // rmc checksum (ubx: first checksum byte, ck_a)
+#ifdef GPS_UBX_PROTOCOL
+    uint8_t checksum_b;  // ubx: second checksum byte, ck_b
+#endif  // GPS_UBX_PROTOCOL
+    uint8_t field;     // current rmc field (ubx: current frame field)
     uint8_t idx;       // character index within current field
 
     // data parsed from rmc line; time from gps is utc/gmt
@@ -57,6 +101,18 @@ typedef struct {
     // gps data-received timers to determine if gps present with good signal
     uint8_t data_timer;  // nonzero if gps data is being received
     uint8_t warn_timer;  // nonzero if gps has signal (status_code == 'A')
+
+#ifdef GPS_DUTY_CYCLE
+    // reception scheduling to skip gps data while clock is synchronized
+    uint16_t sleep_timer;     // nonzero while reception is suspended
+    uint16_t sleep_interval;  // seconds to suspend reception
+    uint8_t  lock_count;      // consecutive fixes agreeing with clock
+    uint8_t  sleep_measure;   // true until first fix after reception resumes
+    int32_t  sleep_offset;    // clock minus gps time at last fix (1/128 s)
+#ifdef GPS_UBX_PROTOCOL
+    uint8_t  ubx_pending;     // receiver output change to send, if any
+#endif  // GPS_UBX_PROTOCOL
+#endif  // GPS_DUTY_CYCLE
 } gps_t;
 
 
@@ -76,6 +132,23 @@ void gps_saverelutc(void);
 
 void gps_settime(void);
 
+#ifdef GPS_DUTY_CYCLE
+void gps_interval(int32_t drift);
+void gps_suspend(void);
+void gps_resume(void);
+#endif  // GPS_DUTY_CYCLE
+
+#if defined(GPS_DUTY_CYCLE) && defined(GPS_UBX_PROTOCOL)
+void gps_idle(void);
+#else
+static inline void gps_idle(void) {};
+#endif  // GPS_DUTY_CYCLE && GPS_UBX_PROTOCOL
+
+#ifdef GPS_UBX_PROTOCOL
+void gps_ubx_send(uint8_t msg_class, uint8_t msg_id,
+		  const uint8_t *payload, uint8_t length);
+#endif  // GPS_UBX_PROTOCOL
+
 #else  // GPS_TIMEKEEPING
 
 static inline void gps_init(void) {};
@@ -86,6 +159,8 @@ static inline void gps_sleep(void) {};
 static inline void gps_tick(void) {};
 static inline void gps_semitick(void) {};
 
+static inline void gps_idle(void) {};
+
 #endif  // GPS_TIMEKEEPING
 
 #endif  // GPS_H
@@ -0,0 +1,35 @@
+// eeprom.h  --  host replacement for <avr/eeprom.h>
+//
+// EEMEM variables are ordinary variables, which serve as the simulated
+// eeprom; the functions in hal.c count writes to eeprom.
+//
+
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>  // for using standard integer types
+#include <stddef.h>  // for size_t
+
+
+#define EEMEM
+
+uint8_t  eeprom_read_byte(const uint8_t *addr);
+uint16_t eeprom_read_word(const uint16_t *addr);
+uint32_t eeprom_read_dword(const uint32_t *addr);
+void     eeprom_read_block(void *dst, const void *src, size_t n);
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_write_word(uint16_t *addr, uint16_t value);
+void eeprom_write_dword(uint32_t *addr, uint32_t value);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_word(uint16_t *addr, uint16_t value);
+void eeprom_update_dword(uint32_t *addr, uint32_t value);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#define eeprom_is_ready() 1
+#define eeprom_busy_wait() do {} while(0)
+
+#endif  // HOST_AVR_EEPROM_H
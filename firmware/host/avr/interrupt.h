@@ -0,0 +1,25 @@
+// interrupt.h  --  host replacement for <avr/interrupt.h>
+//
+// Interrupt service routines become ordinary functions named after
+// their vectors, so the host can invoke them to simulate interrupts.
+//
+
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>  // for SREG
+
+
+#define sei() (SREG |=  _BV(7))
+#define cli() (SREG &= ~_BV(7))
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void); void vector(void) {}
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define reti() return
+
+#endif  // HOST_AVR_INTERRUPT_H
@@ -0,0 +1,371 @@
+// io.h  --  host replacement for <avr/io.h>
+//
+// ATmega328P registers are ordinary variables defined in hal.c, so
+// firmware modules compiled for the host read and write simulated
+// register state.  Register bit numbers match the ATmega328P.
+//
+
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>  // for using standard integer types
+
+
+#define _BV(bit) (1 << (bit))
+
+#define bit_is_set(reg, bit)   ((reg) & _BV(bit))
+#define bit_is_clear(reg, bit) (!((reg) & _BV(bit)))
+
+
+// list of simulated registers; REG8 and REG16 are applied to each
+// eight-bit and sixteen-bit register, respectively
+#define HAL_REGISTERS(REG8, REG16) \
+    REG8(PINB) REG8(DDRB) REG8(PINC) REG8(DDRC) \
+    REG8(PIND) REG8(DDRD) REG8(TIFR0) REG8(TIFR1) \
+    REG8(TIFR2) REG8(PCIFR) REG8(EIFR) REG8(EIMSK) REG8(GPIOR0) \
+    REG8(EEDR) REG8(GPIOR1) REG8(GPIOR2) REG8(TCCR0A) \
+    REG8(TCCR0B) REG8(TCNT0) REG8(OCR0A) REG8(OCR0B) REG8(SPCR) \
+    REG8(SPSR) REG8(SPDR) REG8(SMCR) REG8(MCUSR) REG8(MCUCR) \
+    REG8(SPMCSR) REG8(WDTCSR) REG8(CLKPR) REG8(PRR) REG8(OSCCAL) \
+    REG8(PCICR) REG8(EICRA) REG8(PCMSK0) REG8(PCMSK1) REG8(PCMSK2) \
+    REG8(TIMSK0) REG8(TIMSK1) REG8(TIMSK2) REG8(ADCL) REG8(ADCH) \
+    REG8(ADCSRA) REG8(ADCSRB) REG8(ADMUX) REG8(DIDR0) REG8(DIDR1) \
+    REG8(TCCR1A) REG8(TCCR1B) REG8(TCCR1C) REG8(TCCR2A) REG8(TCCR2B) \
+    REG8(TCNT2) REG8(OCR2A) REG8(OCR2B) REG8(ASSR) REG8(TWBR) REG8(TWSR) \
+    REG8(TWAR) REG8(TWDR) REG8(TWCR) REG8(TWAMR) REG8(UCSR0A) \
+    REG8(UCSR0B) REG8(UCSR0C) REG8(UDR0) REG8(SREG) \
+    REG16(ADC) REG16(ICR1) REG16(OCR1A) REG16(OCR1B) \
+    REG16(UBRR0) REG16(SP)
+
+#define HAL_EXTERN8(reg)  extern volatile uint8_t  reg;
+#define HAL_EXTERN16(reg) extern volatile uint16_t reg;
+HAL_REGISTERS(HAL_EXTERN8, HAL_EXTERN16)
+
+#define ADCW ADC
+
+// EEMEM variables are the simulated eeprom, so the eeprom
+// address register holds a host address (see hal.c)
+extern volatile uintptr_t EEAR;
+
+// output ports are accessed through hal_port() so that host
+// programs can observe each write to a port (see hal.c)
+enum { HAL_PORTB, HAL_PORTC, HAL_PORTD, HAL_PORTS };
+volatile uint8_t *hal_port(uint8_t port);
+
+#define PORTB (*hal_port(HAL_PORTB))
+#define PORTC (*hal_port(HAL_PORTC))
+#define PORTD (*hal_port(HAL_PORTD))
+
+// registers the firmware polls are accessed through functions that
+// advance their state, so busy-wait loops terminate, eeprom
+// programming started through EECR completes, prescaler resets
+// started through GTCCR complete, and the analog comparator output
+// follows simulated power (see hal.c)
+volatile uint8_t  *hal_eecr(void);
+volatile uint16_t *hal_tcnt1(void);
+volatile uint8_t  *hal_acsr(void);
+volatile uint8_t  *hal_gtccr(void);
+
+#define EECR  (*hal_eecr())
+#define TCNT1 (*hal_tcnt1())
+#define ACSR  (*hal_acsr())
+#define GTCCR (*hal_gtccr())
+
+
+// register bit numbers
+#define PB0      0
+#define DDB0     0
+#define PINB0    0
+#define PB1      1
+#define DDB1     1
+#define PINB1    1
+#define PB2      2
+#define DDB2     2
+#define PINB2    2
+#define PB3      3
+#define DDB3     3
+#define PINB3    3
+#define PB4      4
+#define DDB4     4
+#define PINB4    4
+#define PB5      5
+#define DDB5     5
+#define PINB5    5
+#define PB6      6
+#define DDB6     6
+#define PINB6    6
+#define PB7      7
+#define DDB7     7
+#define PINB7    7
+#define PC0      0
+#define DDC0     0
+#define PINC0    0
+#define PC1      1
+#define DDC1     1
+#define PINC1    1
+#define PC2      2
+#define DDC2     2
+#define PINC2    2
+#define PC3      3
+#define DDC3     3
+#define PINC3    3
+#define PC4      4
+#define DDC4     4
+#define PINC4    4
+#define PC5      5
+#define DDC5     5
+#define PINC5    5
+#define PC6      6
+#define DDC6     6
+#define PINC6    6
+#define PC7      7
+#define DDC7     7
+#define PINC7    7
+#define PD0      0
+#define DDD0     0
+#define PIND0    0
+#define PD1      1
+#define DDD1     1
+#define PIND1    1
+#define PD2      2
+#define DDD2     2
+#define PIND2    2
+#define PD3      3
+#define DDD3     3
+#define PIND3    3
+#define PD4      4
+#define DDD4     4
+#define PIND4    4
+#define PD5      5
+#define DDD5     5
+#define PIND5    5
+#define PD6      6
+#define DDD6     6
+#define PIND6    6
+#define PD7      7
+#define DDD7     7
+#define PIND7    7
+#define PCINT0   0
+#define PCINT1   1
+#define PCINT2   2
+#define PCINT3   3
+#define PCINT4   4
+#define PCINT5   5
+#define PCINT6   6
+#define PCINT7   7
+#define PCINT8   0
+#define PCINT9   1
+#define PCINT10  2
+#define PCINT11  3
+#define PCINT12  4
+#define PCINT13  5
+#define PCINT14  6
+#define PCINT15  7
+#define PCINT16  0
+#define PCINT17  1
+#define PCINT18  2
+#define PCINT19  3
+#define PCINT20  4
+#define PCINT21  5
+#define PCINT22  6
+#define PCINT23  7
+#define ACD      7
+#define ACBG     6
+#define ACO      5
+#define ACI      4
+#define ACIE     3
+#define ACIC     2
+#define ACIS1    1
+#define ACIS0    0
+#define ADEN     7
+#define ADSC     6
+#define ADATE    5
+#define ADIF     4
+#define ADIE     3
+#define ADPS2    2
+#define ADPS1    1
+#define ADPS0    0
+#define REFS1    7
+#define REFS0    6
+#define ADLAR    5
+#define MUX3     3
+#define MUX2     2
+#define MUX1     1
+#define MUX0     0
+#define ACME     6
+#define ADTS2    2
+#define ADTS1    1
+#define ADTS0    0
+#define ADC5D    5
+#define ADC4D    4
+#define ADC3D    3
+#define ADC2D    2
+#define ADC1D    1
+#define ADC0D    0
+#define AIN1D    1
+#define AIN0D    0
+#define COM0A1   7
+#define COM0A0   6
+#define COM0B1   5
+#define COM0B0   4
+#define WGM01    1
+#define WGM00    0
+#define FOC0A    7
+#define FOC0B    6
+#define WGM02    3
+#define CS02     2
+#define CS01     1
+#define CS00     0
+#define OCIE0B   2
+#define OCIE0A   1
+#define TOIE0    0
+#define OCF0B    2
+#define OCF0A    1
+#define TOV0     0
+#define COM1A1   7
+#define COM1A0   6
+#define COM1B1   5
+#define COM1B0   4
+#define WGM11    1
+#define WGM10    0
+#define ICNC1    7
+#define ICES1    6
+#define WGM13    4
+#define WGM12    3
+#define CS12     2
+#define CS11     1
+#define CS10     0
+#define ICIE1    5
+#define OCIE1B   2
+#define OCIE1A   1
+#define TOIE1    0
+#define ICF1     5
+#define OCF1B    2
+#define OCF1A    1
+#define TOV1     0
+#define COM2A1   7
+#define COM2A0   6
+#define COM2B1   5
+#define COM2B0   4
+#define WGM21    1
+#define WGM20    0
+#define FOC2A    7
+#define FOC2B    6
+#define WGM22    3
+#define CS22     2
+#define CS21     1
+#define CS20     0
+#define OCIE2B   2
+#define OCIE2A   1
+#define TOIE2    0
+#define OCF2B    2
+#define OCF2A    1
+#define TOV2     0
+#define EXCLK    6
+#define AS2      5
+#define TCN2UB   4
+#define OCR2AUB  3
+#define OCR2BUB  2
+#define TCR2AUB  1
+#define TCR2BUB  0
+#define PSRASY   1
+#define PSRSYNC  0
+#define TSM      7
+#define RXC0     7
+#define TXC0     6
+#define UDRE0    5
+#define FE0      4
+#define DOR0     3
+#define UPE0     2
+#define U2X0     1
+#define MPCM0    0
+#define RXCIE0   7
+#define TXCIE0   6
+#define UDRIE0   5
+#define RXEN0    4
+#define TXEN0    3
+#define UCSZ02   2
+#define RXB80    1
+#define TXB80    0
+#define UMSEL01  7
+#define UMSEL00  6
+#define UPM01    5
+#define UPM00    4
+#define USBS0    3
+#define UCSZ01   2
+#define UCSZ00   1
+#define UCPOL0   0
+#define WDRF     3
+#define BORF     2
+#define EXTRF    1
+#define PORF     0
+#define WDIF     7
+#define WDIE     6
+#define WDP3     5
+#define WDCE     4
+#define WDE      3
+#define WDP2     2
+#define WDP1     1
+#define WDP0     0
+#define BODS     6
+#define BODSE    5
+#define PUD      4
+#define IVSEL    1
+#define IVCE     0
+#define SM2      3
+#define SM1      2
+#define SM0      1
+#define SE       0
+#define PRTWI    7
+#define PRTIM2   6
+#define PRTIM0   5
+#define PRTIM1   3
+#define PRSPI    2
+#define PRUSART0 1
+#define PRADC    0
+#define PCIE2    2
+#define PCIE1    1
+#define PCIE0    0
+#define PCIF2    2
+#define PCIF1    1
+#define PCIF0    0
+#define INT1     1
+#define INT0     0
+#define INTF1    1
+#define INTF0    0
+#define ISC11    3
+#define ISC10    2
+#define ISC01    1
+#define ISC00    0
+#define EERE     0
+#define EEPE     1
+#define EEMPE    2
+#define EERIE    3
+#define EEPM0    4
+#define EEPM1    5
+#define SPIE     7
+#define SPE      6
+#define DORD     5
+#define MSTR     4
+#define CPOL     3
+#define CPHA     2
+#define SPR1     1
+#define SPR0     0
+#define SPIF     7
+#define SPI2X    0
+#define CLKPCE   7
+
+
+// fuse and lock bits are not simulated
+#define FUSES    struct { uint8_t low, high, extended; } hal_fuses
+#define LOCKBITS uint8_t hal_lockbits
+
+#define LB_MODE_1   0xFF
+#define LB_MODE_3   0xFC
+#define BLB0_MODE_1 0xFF
+#define BLB0_MODE_2 0xFB
+#define BLB1_MODE_1 0xFF
+#define BLB1_MODE_2 0xEF
+
+#endif  // HOST_AVR_IO_H
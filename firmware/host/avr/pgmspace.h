@@ -0,0 +1,28 @@
+// pgmspace.h  --  host replacement for <avr/pgmspace.h>
+//
+// The host has a single address space, so program memory
+// data are ordinary constants.
+//
+
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>  // for using standard integer types
+#include <string.h>  // for strlen()
+
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+typedef const char *PGM_P;
+
+#define pgm_read_byte(addr)  (*(const uint8_t  *)(addr))
+// words are read with the type addressed, so tables of pointers
+// (which are words on the avr) are read at full host width
+#define pgm_read_word(addr)  (*(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+#define strlen_P strlen
+
+#endif  // HOST_AVR_PGMSPACE_H
@@ -0,0 +1,48 @@
+// power.h  --  host replacement for <avr/power.h>
+//
+// Module power and the clock prescaler are set in the simulated
+// PRR and CLKPR registers.
+//
+
+
+#ifndef HOST_AVR_POWER_H
+#define HOST_AVR_POWER_H
+
+#include <avr/io.h>  // for PRR and CLKPR
+
+
+#define power_adc_enable()     (PRR &= ~_BV(PRADC))
+#define power_adc_disable()    (PRR |=  _BV(PRADC))
+#define power_usart0_enable()  (PRR &= ~_BV(PRUSART0))
+#define power_usart0_disable() (PRR |=  _BV(PRUSART0))
+#define power_spi_enable()     (PRR &= ~_BV(PRSPI))
+#define power_spi_disable()    (PRR |=  _BV(PRSPI))
+#define power_twi_enable()     (PRR &= ~_BV(PRTWI))
+#define power_twi_disable()    (PRR |=  _BV(PRTWI))
+#define power_timer0_enable()  (PRR &= ~_BV(PRTIM0))
+#define power_timer0_disable() (PRR |=  _BV(PRTIM0))
+#define power_timer1_enable()  (PRR &= ~_BV(PRTIM1))
+#define power_timer1_disable() (PRR |=  _BV(PRTIM1))
+#define power_timer2_enable()  (PRR &= ~_BV(PRTIM2))
+#define power_timer2_disable() (PRR |=  _BV(PRTIM2))
+#define power_all_enable()     (PRR = 0)
+#define power_all_disable()    (PRR = _BV(PRADC) | _BV(PRUSART0) \
+				    | _BV(PRSPI) | _BV(PRTWI) | _BV(PRTIM0) \
+				    | _BV(PRTIM1) | _BV(PRTIM2))
+
+typedef enum {
+    clock_div_1,
+    clock_div_2,
+    clock_div_4,
+    clock_div_8,
+    clock_div_16,
+    clock_div_32,
+    clock_div_64,
+    clock_div_128,
+    clock_div_256,
+} clock_div_t;
+
+#define clock_prescale_set(div) (CLKPR = (div))
+#define clock_prescale_get()    ((clock_div_t)(CLKPR & 0x0F))
+
+#endif  // HOST_AVR_POWER_H
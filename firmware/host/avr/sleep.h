@@ -0,0 +1,34 @@
+// sleep.h  --  host replacement for <avr/sleep.h>
+//
+// Sleep mode is set in the simulated SMCR register; sleep_cpu()
+// calls hal_sleep(), which returns immediately.
+//
+
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include <avr/io.h>  // for SMCR and MCUCR
+
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_ADC          _BV(SM0)
+#define SLEEP_MODE_PWR_DOWN     _BV(SM1)
+#define SLEEP_MODE_PWR_SAVE     (_BV(SM0) | _BV(SM1))
+#define SLEEP_MODE_STANDBY      (_BV(SM1) | _BV(SM2))
+#define SLEEP_MODE_EXT_STANDBY  (_BV(SM0) | _BV(SM1) | _BV(SM2))
+
+#define set_sleep_mode(mode) \
+    (SMCR = (SMCR & ~(_BV(SM0) | _BV(SM1) | _BV(SM2))) | (mode))
+
+#define sleep_enable()      (SMCR |=  _BV(SE))
+#define sleep_disable()     (SMCR &= ~_BV(SE))
+#define sleep_bod_disable() (MCUCR |= _BV(BODS))
+
+void hal_sleep(void);
+
+#define sleep_cpu() hal_sleep()
+#define sleep_mode() do { sleep_enable(); sleep_cpu(); sleep_disable(); } \
+		     while(0)
+
+#endif  // HOST_AVR_SLEEP_H
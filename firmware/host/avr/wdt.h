@@ -0,0 +1,30 @@
+// wdt.h  --  host replacement for <avr/wdt.h>
+//
+// The watchdog is configured in the simulated WDTCSR register.
+//
+
+
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+
+#include <avr/io.h>  // for WDTCSR
+
+
+#define WDTO_15MS  0
+#define WDTO_30MS  1
+#define WDTO_60MS  2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S    6
+#define WDTO_2S    7
+#define WDTO_4S    8
+#define WDTO_8S    9
+
+#define wdt_enable(timeout) \
+    (WDTCSR = _BV(WDE) | ((timeout) & 0x07) \
+	      | ((timeout) & 0x08 ? _BV(WDP3) : 0))
+#define wdt_disable() (WDTCSR = 0)
+#define wdt_reset()   do {} while(0)
+
+#endif  // HOST_AVR_WDT_H
@@ -0,0 +1,376 @@
+// drift.c  --  simulates long-term timekeeping with a modelled crystal
+//
+// Timer2 interrupts are simulated from a model of the crystal: each
+// "second" lasts OCR2A + 1 counts at 128 Hz, and the crystal runs
+// fast or slow by a fixed offset, by aging, and by a parabolic
+// temperature dependence.  Temperature follows daily and seasonal
+// cycles.  Only the timekeeping code (time.c and, if configured,
+// temperature compensation in temp.c) runs, so years of clock time
+// take seconds.  A report line is printed every 30 days, giving the
+// clock error against true time, the number of time sets and slews,
+// and the eeprom writes so far.
+//
+// usage: drift [-y years] [-o ppm] [-a ppm/year] [-k ppm/degC^2]
+//              [-t degC] [-d degC] [-s degC] [script]
+//
+//    -y   simulated years (default 1)
+//    -o   crystal frequency offset at turnover temperature (ppm)
+//    -a   aging (ppm per year)
+//    -k   temperature coefficient (ppm per deg C squared)
+//    -t   mean temperature (deg C)
+//    -d   daily temperature swing (deg C, peak to peak)
+//    -s   seasonal temperature swing (deg C, peak to peak)
+//
+// Each script line is "<days> <action>", in order of time, where
+// action is one of:
+//
+//    set            set the time by hand to the true time
+//    gps <hours>    synchronize to gps every <hours> (0 stops)
+//
+// Lines starting with "#" are ignored.  The time is always set at
+// the start of the simulation.
+//
+
+
+#include <stdint.h>       // for using standard integer types
+#include <stdio.h>        // for reading scripts and printing reports
+#include <math.h>         // for sin() and fabs()
+#include <unistd.h>       // for getopt()
+#include <avr/io.h>       // for simulated registers
+
+#include "hal.h"
+#include "config.h"
+#include "time.h"
+#include "temp.h"
+
+
+// simulation parameters
+#define DRIFT_REPORT_DAYS  30     // days between report lines
+#define DRIFT_TEMP_SECONDS 60     // seconds between temperature readings
+#define DRIFT_SCRIPT_SIZE  256    // maximum script lines
+#define DRIFT_DAY          86400  // seconds per day
+#define DRIFT_YEAR         (365.25 * DRIFT_DAY)
+
+#ifdef XTAL_TURNOVER_TEMP
+#define DRIFT_TURNOVER (XTAL_TURNOVER_TEMP / 16.0)  // deg C
+#else
+#define DRIFT_TURNOVER 25.0
+#endif  // XTAL_TURNOVER_TEMP
+
+#ifdef XTAL_FREQUENCY_COEF
+#define DRIFT_COEF (XTAL_FREQUENCY_COEF / 1000.0)  // ppm per deg C^2
+#else
+#define DRIFT_COEF 0.034
+#endif  // XTAL_FREQUENCY_COEF
+
+
+#ifdef TEMPERATURE_SENSOR
+// defined in temp.c, but not declared in temp.h
+void temp_calc_error(void);
+#endif  // TEMPERATURE_SENSOR
+
+
+typedef struct {
+    double days;    // when action occurs
+    double hours;   // gps interval; negative for a manual set
+} drift_action_t;
+
+
+typedef struct {
+    double now;       // true time since start (seconds)
+    double epoch;     // true standard time at start (seconds since 2000)
+    double end;       // end of simulation (seconds)
+
+    // crystal model
+    double offset;    // frequency offset (ppm)
+    double aging;     // frequency change per year (ppm)
+    double coef;      // temperature coefficient (ppm per deg C^2)
+    double temp;      // mean temperature (deg C)
+    double daily;     // daily temperature swing (deg C)
+    double seasonal;  // seasonal temperature swing (deg C)
+
+    drift_action_t script[DRIFT_SCRIPT_SIZE];
+    uint16_t script_len;
+    uint16_t script_idx;
+    double gps_interval;  // seconds; zero when gps is off
+    double gps_due;       // time of next gps synchronization
+
+    // statistics
+    uint32_t sets;        // times the time was set
+    uint32_t slews;       // times the time was slewed
+    uint32_t adjusted;    // seconds lengthened or shortened
+    uint32_t dst_changes; // daylight saving time changes
+    double error_max;     // largest absolute error (seconds)
+} drift_t;
+
+
+static drift_t drift;
+
+
+// returns clock time as standard time in seconds since 2000
+static double drift_clock(void) {
+    uint32_t days = time.year * 365UL + (time.year + 3) / 4;
+
+    for(uint8_t month = 1; month < time.month; ++month) {
+	days += time_daysinmonth(time.year, month);
+    }
+    days += time.day - 1;
+
+    double seconds = days * (double)DRIFT_DAY + time.hour * 3600UL
+		   + (time.minute * 60UL) + time.second + time.lazy_seconds;
+
+    if(time.status & TIME_DST) seconds -= 3600;
+
+    return seconds;
+}
+
+
+// returns the crystal temperature at the current time (deg C)
+static double drift_temperature(void) {
+    return drift.temp
+	 + drift.daily    / 2 * sin(2 * M_PI * drift.now / DRIFT_DAY)
+	 + drift.seasonal / 2 * sin(2 * M_PI * drift.now / DRIFT_YEAR);
+}
+
+
+// returns the crystal frequency error at the current time (ppm)
+static double drift_ppm(void) {
+    double delta = drift_temperature() - DRIFT_TURNOVER;
+
+    return drift.offset + drift.aging * drift.now / DRIFT_YEAR
+	 - drift.coef * delta * delta;
+}
+
+
+// sets the clock to the true time, as with a time set by hand
+static void drift_set(void) {
+    uint32_t local = drift.epoch + drift.now;
+    uint32_t days  = local / DRIFT_DAY;
+    uint8_t year   = 0;
+    uint8_t month  = 1;
+
+    // the date is set first, so dst is known for the hour
+    while(days >= 365U + !(year % 4)) days -= 365 + !(year++ % 4);
+    while(days >= time_daysinmonth(year, month)) {
+	days -= time_daysinmonth(year, month++);
+    }
+
+    time_setdate(year, month, days + 1);
+    time_autodst(FALSE);
+    if(time.status & TIME_DST) local += 3600;
+
+    time_settime(local / 3600 % 24, local / 60 % 60, local % 60);
+    ++drift.sets;
+}
+
+
+// corrects the clock from gps, as in gps_settime()
+static void drift_gps(void) {
+    int32_t diff = (int32_t)(drift.epoch + drift.now) - drift_clock();
+
+    if(!diff || time.slew_adjust) return;
+
+    if(-TIME_SLEW_MAX <= diff && diff <= TIME_SLEW_MAX) {
+	time_slewtime(diff);
+	++drift.slews;
+    } else {
+	drift_set();
+    }
+}
+
+
+// prints a report line
+static void drift_report(void) {
+    printf("%7.1f  %10.3f  %6lu  %6lu  %9lu  %6d\n",
+	    drift.now / DRIFT_DAY, drift_clock() - drift.epoch - drift.now,
+	    (unsigned long)drift.sets, (unsigned long)drift.slews,
+	    (unsigned long)hal.eeprom_writes, time.drift_adjust);
+}
+
+
+// returns the true duration of the current timer2 period
+static double drift_period(void) {
+    return (OCR2A + 1) / 128.0 / (1 + drift_ppm() / 1000000);
+}
+
+
+// performs due script actions; actions occur at the
+// start of a true second, when a person or gps would
+static void drift_script(void) {
+    while(drift.script_idx < drift.script_len
+	    && drift.script[drift.script_idx].days * DRIFT_DAY <= drift.now) {
+	drift_action_t *action = &drift.script[drift.script_idx++];
+
+	if(action->hours < 0) {
+	    drift_set();
+	} else {
+	    drift.gps_interval = action->hours * 3600;
+	    drift.gps_due      = drift.now;
+	}
+    }
+
+    if(drift.gps_interval && drift.gps_due <= drift.now) {
+	drift_gps();
+	drift.gps_due += drift.gps_interval;
+    }
+}
+
+
+// runs the simulation
+static void drift_run(void) {
+    double report = 0;
+    double second = 1;                // next true second
+    double start  = drift.now;        // true start of timer2 period
+    double tick   = drift_period();   // true end of timer2 period
+    uint8_t dst = time.status & TIME_DST;
+#ifdef TEMPERATURE_SENSOR
+    uint8_t temp_timer = 0;
+#endif  // TEMPERATURE_SENSOR
+
+    printf("    day   error (s)    sets   slews  eeprom wr   drift\n");
+
+    while(drift.now < drift.end) {
+	// time sets happen at the start of a true second
+	if(second < tick) {
+	    uint32_t sets = drift.sets;
+
+	    drift.now = second++;
+	    TCNT2 = (drift.now - start) * 128 * (1 + drift_ppm() / 1000000);
+	    drift_script();
+
+	    // setting the time restarts the timer2 period
+	    if(drift.sets != sets) {
+		start = drift.now;
+		tick  = start + drift_period();
+	    }
+	    continue;
+	}
+
+	drift.now = start = tick;
+	if(OCR2A != 127) ++drift.adjusted;
+	time_tick();
+
+#ifdef TEMPERATURE_SENSOR
+	// read temperature as temp_tick() would
+	++temp.int_timer;
+	if(++temp_timer >= DRIFT_TEMP_SECONDS) {
+	    temp_timer = 0;
+	    temp.temp = drift_temperature() * 16;
+	    temp_calc_error();
+	    temp.int_timer = 0;
+	}
+#endif  // TEMPERATURE_SENSOR
+
+	if((time.status & TIME_DST) != dst) {
+	    dst ^= TIME_DST;
+	    ++drift.dst_changes;
+	}
+
+	double error = fabs(drift_clock() - drift.epoch - drift.now);
+	if(error > drift.error_max) drift.error_max = error;
+
+	if(drift.now >= report) {
+	    drift_report();
+	    report += DRIFT_REPORT_DAYS * DRIFT_DAY;
+	}
+
+	tick = start + drift_period();
+    }
+
+    drift_report();
+
+    printf("\nlargest error: %.3f seconds\n", drift.error_max);
+    printf("adjusted seconds: %lu\n", (unsigned long)drift.adjusted);
+    printf("dst changes: %lu\n", (unsigned long)drift.dst_changes);
+}
+
+
+// reads a script of timed actions
+static int drift_load(FILE *file) {
+    char line[128];
+
+    while(fgets(line, sizeof(line), file)) {
+	drift_action_t action;
+
+	if(line[0] == '#' || line[0] == '\n') continue;
+
+	if(drift.script_len >= DRIFT_SCRIPT_SIZE) {
+	    fprintf(stderr, "drift: script too long\n");
+	    return 1;
+	}
+
+	if(sscanf(line, "%lf gps %lf", &action.days, &action.hours) == 2
+		&& action.hours >= 0) {
+	    // gps synchronization interval
+	} else if(sscanf(line, "%lf set", &action.days) == 1) {
+	    action.hours = -1;
+	} else {
+	    fprintf(stderr, "drift: bad script line: %s", line);
+	    return 1;
+	}
+
+	drift.script[drift.script_len++] = action;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    double years = 1;
+    int opt, bad = 0;
+
+    drift.coef = DRIFT_COEF;
+    drift.temp = DRIFT_TURNOVER;
+
+    while((opt = getopt(argc, argv, "y:o:a:k:t:d:s:")) != -1) {
+	double *param;
+
+	switch(opt) {
+	    case 'y': param = &years;          break;
+	    case 'o': param = &drift.offset;   break;
+	    case 'a': param = &drift.aging;    break;
+	    case 'k': param = &drift.coef;     break;
+	    case 't': param = &drift.temp;     break;
+	    case 'd': param = &drift.daily;    break;
+	    case 's': param = &drift.seasonal; break;
+	    default:  param = NULL;            break;
+	}
+
+	if(!param || sscanf(optarg, "%lf", param) != 1) bad = 1;
+    }
+
+    if(bad || argc - optind > 1) {
+	fprintf(stderr, "usage: drift [-y years] [-o ppm] [-a ppm/year] "
+		"[-k ppm/degC^2]\n             [-t degC] [-d degC] "
+		"[-s degC] [script]\n");
+	return 1;
+    }
+
+    if(argc - optind == 1) {
+	FILE *file = fopen(argv[optind], "r");
+	if(!file) {
+	    perror(argv[optind]);
+	    return 1;
+	}
+	int err = drift_load(file);
+	fclose(file);
+	if(err) return 1;
+    }
+
+    drift.end = years * DRIFT_YEAR;
+
+    time_init();
+#ifdef TEMPERATURE_SENSOR
+    temp_init();
+#endif  // TEMPERATURE_SENSOR
+
+    // start at the default time, which is then set
+    OCR2A = 127;
+    drift.epoch = drift_clock();
+    drift_set();
+
+    drift_run();
+
+    return 0;
+}
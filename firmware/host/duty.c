@@ -0,0 +1,244 @@
+// duty.c  --  analyzes MAX6921 pin captures for display uniformity
+//
+// Reads "seconds,din,clk,load,blank" lines, as written by "vfd -c" or
+// exported from a logic analyzer attached to the MAX6921 DIN, CLK,
+// LOAD and BLANK pins, and decodes the latched outputs.  The report
+// gives the duty cycle of every segment on every digit, the refresh
+// rate and on-time of each digit, and the ghosting windows: changes
+// of the latched outputs while the display is not blanked.
+//
+// usage: duty [capture]
+//
+// Lines starting with "#" are copied to the report, so the capture
+// can record the configuration it was made with.
+//
+
+
+#include <stdint.h>       // for using standard integer types
+#include <stdio.h>        // for reading captures and printing reports
+#include <avr/io.h>       // for _BV()
+#include <avr/pgmspace.h> // for pgm_read_byte()
+
+#include "config.h"
+#include "display.h"
+
+
+// defined in display.c
+extern const uint8_t vfd_digit_pins[];
+extern const uint8_t vfd_segment_pins[];
+
+
+typedef struct {
+    double now;      // time of current capture line (seconds)
+    double start;    // time of first capture line
+    double changed;  // time of last latch or blank change
+
+    uint32_t shift;  // MAX6921 shift register
+    uint32_t latch;  // MAX6921 latched outputs
+    uint8_t clk, blank;   // pin levels
+
+    double on_time[DISPLAY_SIZE][8];  // segment lit (seconds)
+    double digit_time[DISPLAY_SIZE];  // digit unblanked (seconds)
+    uint32_t refreshes[DISPLAY_SIZE]; // times digit was lit
+
+    uint32_t latches;      // latch changes
+    uint32_t ghosts;       // latch changes while unblanked
+    double blank_time;     // display blanked (seconds)
+    double blank_min;      // shortest blanking between latches
+} duty_t;
+
+
+static duty_t duty;
+
+
+// returns the display index driven by a MAX6921 output or -1
+static int8_t duty_digit(uint8_t pin) {
+    for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	if(pgm_read_byte(&vfd_digit_pins[idx]) == pin) return idx;
+    }
+
+    return -1;
+}
+
+
+// returns the segment index driven by a MAX6921 output or -1
+static int8_t duty_segment(uint8_t pin) {
+    for(uint8_t seg = 0; seg < 8; ++seg) {
+	if(pgm_read_byte(&vfd_segment_pins[seg]) == pin) return seg;
+    }
+
+    return -1;
+}
+
+
+// credits the latched outputs with the time since the last change
+static void duty_account(void) {
+    double elapsed = duty.now - duty.changed;
+    duty.changed = duty.now;
+
+    if(duty.blank) {
+	duty.blank_time += elapsed;
+	return;
+    }
+
+    for(uint8_t pin = 0; pin < 20; ++pin) {
+	int8_t idx = duty_digit(pin);
+	if(idx < 0 || !(duty.latch & (1UL << pin))) continue;
+
+	duty.digit_time[idx] += elapsed;
+
+	for(uint8_t seg_pin = 0; seg_pin < 20; ++seg_pin) {
+	    int8_t seg = duty_segment(seg_pin);
+	    if(seg >= 0 && (duty.latch & (1UL << seg_pin))) {
+		duty.on_time[idx][seg] += elapsed;
+	    }
+	}
+    }
+}
+
+
+// counts digits that are lit by the latched outputs
+static void duty_refresh(void) {
+    if(duty.blank) return;
+
+    for(uint8_t pin = 0; pin < 20; ++pin) {
+	int8_t idx = duty_digit(pin);
+	if(idx >= 0 && (duty.latch & (1UL << pin))) ++duty.refreshes[idx];
+    }
+}
+
+
+// decodes one capture line
+static void duty_sample(uint8_t din, uint8_t clk,
+			uint8_t load, uint8_t blank) {
+    // shift DIN on rising edge of CLK
+    if(clk && !duty.clk) {
+	duty.shift = ((duty.shift << 1) | din) & 0xFFFFF;
+    }
+
+    // transfer shift register to outputs while LOAD is high
+    if(load && duty.shift != duty.latch) {
+	double blanked = duty.now - duty.changed;
+
+	if(duty.blank) {
+	    if(duty.latches && blanked < duty.blank_min) {
+		duty.blank_min = blanked;
+	    }
+	} else {
+	    ++duty.ghosts;
+	}
+
+	duty_account();
+	duty.latch = duty.shift;
+	++duty.latches;
+	duty_refresh();
+    }
+
+    if(blank != duty.blank) {
+	duty_account();
+	duty.blank = blank;
+	duty_refresh();
+    }
+
+    duty.clk = clk;
+}
+
+
+// prints duty cycles, refresh rates, and ghosting
+static void duty_report(void) {
+    static const char segments[] = "HGFEDCBA";
+    double seconds = duty.now - duty.start;
+    double seg_min = 1, seg_max = 0;
+
+    if(seconds <= 0) {
+	printf("empty capture\n");
+	return;
+    }
+
+    printf("segment duty cycle (%%)\n");
+    printf("digit");
+    for(int8_t seg = 7; seg >= 0; --seg) printf("  %6c", segments[seg]);
+    printf("\n");
+
+    for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	printf("%5u", idx);
+	for(int8_t seg = 7; seg >= 0; --seg) {
+	    double d = duty.on_time[idx][seg] / seconds;
+	    printf("  %6.2f", 100 * d);
+
+	    if(d > 0) {
+		if(d < seg_min) seg_min = d;
+		if(d > seg_max) seg_max = d;
+	    }
+	}
+	printf("\n");
+    }
+
+    printf("\ndigit  refresh (Hz)  on-time (%%)\n");
+    for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	printf("%5u  %12.1f  %11.2f\n", idx,
+		duty.refreshes[idx] / seconds,
+		100 * duty.digit_time[idx] / seconds);
+    }
+
+    printf("\ncapture: %.6f seconds\n", seconds);
+    if(seg_max > 0) {
+	printf("lit segment duty: %.2f%% to %.2f%% (uniformity %.3f)\n",
+		100 * seg_min, 100 * seg_max, seg_min / seg_max);
+    }
+    printf("blanked: %.2f%%\n", 100 * duty.blank_time / seconds);
+    printf("latches: %lu (%.1f per second)\n",
+	    (unsigned long)duty.latches, duty.latches / seconds);
+    printf("ghosting windows: %lu\n", (unsigned long)duty.ghosts);
+    if(duty.blank_min < 1e9) {
+	printf("shortest blanking: %.6f seconds\n", duty.blank_min);
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    FILE *file = stdin;
+    char line[128];
+    uint32_t samples = 0;
+
+    if(argc > 2) {
+	fprintf(stderr, "usage: duty [capture]\n");
+	return 1;
+    }
+
+    if(argc == 2) {
+	file = fopen(argv[1], "r");
+	if(!file) {
+	    perror(argv[1]);
+	    return 1;
+	}
+    }
+
+    duty.blank_min = 1e9;
+
+    while(fgets(line, sizeof(line), file)) {
+	unsigned din, clk, load, blank;
+	double now;
+
+	if(line[0] == '#') {
+	    fputs(line, stdout);
+	    continue;
+	}
+
+	if(sscanf(line, "%lf,%u,%u,%u,%u",
+		    &now, &din, &clk, &load, &blank) != 5) {
+	    continue;  // skip headers and malformed lines
+	}
+
+	if(!samples++) duty.start = duty.changed = now;
+	duty.now = now;
+	duty_sample(din != 0, clk != 0, load != 0, blank != 0);
+    }
+
+    duty_account();
+    duty_report();
+
+    if(file != stdin) fclose(file);
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+// hal.c  --  simulated ATmega328P state for host builds
+//
+// Firmware modules compiled with "make host" use the replacement avr
+// headers in host/avr and host/util, which access the registers and
+// eeprom defined here rather than hardware.  Nothing advances on its
+// own: a host program drives the firmware by setting registers (e.g.
+// PIND or ADC), calling interrupt vectors, and inspecting the result.
+// Hardware side effects of register writes are generally not
+// simulated; the exceptions are output ports, which report writes,
+// and the registers the firmware polls (EECR, TCNT1, ACSR, and GTCCR).
+// Eeprom programming started through EECR erases or writes the byte
+// at EEAR, and the analog comparator output, ACO, is set while
+// hal.battery is.
+//
+// This is not an avr simulator such as simavr.  The firmware is built
+// by the host compiler and runs at host speed, so nothing here models
+// instruction timing, interrupt latency or priority, interrupts
+// arriving while others are disabled, timer and adc hardware, sleep
+// mode and clock prescaler behavior, or flash and ram limits.  Host
+// programs check what the firmware decides and writes, not when:
+// 1-Wire slot timing, wake from power-save, and the length of the
+// power-fail path are not verified by them.
+//
+
+
+#include <avr/io.h>      // for simulated register declarations
+#include <avr/eeprom.h>  // for eeprom function declarations
+#include <avr/sleep.h>   // for hal_sleep() declaration
+#include <string.h>      // for memcpy()
+#include <time.h>        // for clock_gettime()
+
+#include "hal.h"
+
+
+// simulated registers
+#define HAL_DEFINE8(reg)  volatile uint8_t  reg;
+#define HAL_DEFINE16(reg) volatile uint16_t reg;
+HAL_REGISTERS(HAL_DEFINE8, HAL_DEFINE16)
+volatile uintptr_t EEAR;
+
+
+// extern'ed simulation statistics and hooks
+hal_t hal;
+
+// simulated output ports
+volatile uint8_t hal_ports[HAL_PORTS];
+
+
+// returns the address of a port for the firmware to read or write;
+// the write lands after this function returns, so it is reported to
+// the port hook by the next port access or hal_port_flush()
+volatile uint8_t *hal_port(uint8_t port) {
+    hal_port_flush();
+    return &hal_ports[port];
+}
+
+
+// eeprom programming completes by the next access to EECR; as on
+// the avr, EEPM1:0 select erase and write, erase only, or write only
+volatile uint8_t *hal_eecr(void) {
+    static volatile uint8_t eecr;
+
+    if(eecr & _BV(EEPE)) {
+	uint8_t *addr = (uint8_t *)EEAR;
+
+	switch(eecr & (_BV(EEPM1) | _BV(EEPM0))) {
+	    case 0:
+		*addr = EEDR;
+		break;
+	    case _BV(EEPM0):
+		*addr = 0xFF;
+		break;
+	    case _BV(EEPM1):
+		*addr &= EEDR;
+		break;
+	    default:
+		break;
+	}
+
+	eecr &= ~_BV(EEPE);
+	++hal.eeprom_writes;
+    }
+
+    return &eecr;
+}
+
+
+// timer/counter1 counts once per access while clocked; the
+// buzzer runs timer/counter1 in fast pwm mode with ICR1 as top
+volatile uint16_t *hal_tcnt1(void) {
+    static volatile uint16_t tcnt1;
+
+    if(TCCR1B & (_BV(CS12) | _BV(CS11) | _BV(CS10))) {
+	tcnt1 = (tcnt1 < ICR1 ? tcnt1 + 1 : 0);
+    }
+
+    return &tcnt1;
+}
+
+
+// prescaler resets complete by the next access to GTCCR; on the avr,
+// PSRASY remains set until the asynchronous timer2 prescaler is reset
+volatile uint8_t *hal_gtccr(void) {
+    static volatile uint8_t gtccr;
+
+    gtccr &= ~(_BV(PSRASY) | _BV(PSRSYNC));
+
+    return &gtccr;
+}
+
+
+// the analog comparator output is set while adaptor power is cut,
+// when AIN1 falls below the bandgap reference; the firmware cannot
+// change ACO, so it is reapplied on every access
+volatile uint8_t *hal_acsr(void) {
+    static volatile uint8_t acsr;
+
+    if(hal.battery) {
+	acsr |= _BV(ACO);
+    } else {
+	acsr &= ~_BV(ACO);
+    }
+
+    return &acsr;
+}
+
+
+// report port changes since the previous call to the port hook;
+// because every port access flushes, changes are reported in order
+void hal_port_flush(void) {
+    static uint8_t reported[HAL_PORTS];
+
+    for(uint8_t port = 0; port < HAL_PORTS; ++port) {
+	if(hal_ports[port] != reported[port]) {
+	    reported[port] = hal_ports[port];
+	    if(hal.port_hook) hal.port_hook(port, reported[port]);
+	}
+    }
+}
+
+
+// called by sleep_cpu(); the processor wakes immediately
+// unless the sleep hook simulates the passage of time
+void hal_sleep(void) {
+    ++hal.sleeps;
+    if(hal.sleep_hook) hal.sleep_hook();
+}
+
+
+// monotonic host time for timing firmware code
+uint64_t hal_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+// EEMEM variables are the simulated eeprom, so eeprom access is
+// ordinary memory access; like avr-libc, each function first waits
+// for programming started through EECR to complete
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+    (void)EECR;
+    return *addr;
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr) {
+    (void)EECR;
+    return *addr;
+}
+
+uint32_t eeprom_read_dword(const uint32_t *addr) {
+    (void)EECR;
+    return *addr;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+    (void)EECR;
+    memcpy(dst, src, n);
+}
+
+
+void eeprom_write_block(const void *src, void *dst, size_t n) {
+    (void)EECR;
+    memcpy(dst, src, n);
+    hal.eeprom_writes += n;
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_word(uint16_t *addr, uint16_t value) {
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+void eeprom_write_dword(uint32_t *addr, uint32_t value) {
+    eeprom_write_block(&value, addr, sizeof(value));
+}
+
+
+// like avr-libc, only bytes that differ are written
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+
+    for(; n; --n, ++s, ++d) {
+	if(*d != *s) eeprom_write_block(s, d, 1);
+    }
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+    eeprom_update_block(&value, addr, sizeof(value));
+}
+
+void eeprom_update_word(uint16_t *addr, uint16_t value) {
+    eeprom_update_block(&value, addr, sizeof(value));
+}
+
+void eeprom_update_dword(uint32_t *addr, uint32_t value) {
+    eeprom_update_block(&value, addr, sizeof(value));
+}
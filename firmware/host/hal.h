@@ -0,0 +1,32 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>  // for using standard integer types
+#include <avr/io.h>  // for HAL_PORTS
+
+
+typedef struct {
+    uint32_t eeprom_writes;  // bytes programmed in simulated eeprom
+    uint32_t sleeps;         // calls to sleep_cpu()
+    uint8_t  battery;        // nonzero while adaptor power is cut
+
+    // called from sleep_cpu(); may advance simulated time by
+    // updating registers and calling interrupt vectors
+    void (*sleep_hook)(void);
+
+    // called with the new value whenever an output port changes;
+    // must not call back into the firmware
+    void (*port_hook)(uint8_t port, uint8_t value);
+} hal_t;
+
+
+extern hal_t hal;
+extern volatile uint8_t hal_ports[HAL_PORTS];
+
+
+void hal_sleep(void);
+void hal_port_flush(void);
+
+uint64_t hal_nanoseconds(void);
+
+#endif
@@ -0,0 +1,143 @@
+// hostbench.c  --  times frequently called firmware functions on the host
+//
+// Each benchmark calls a function repeatedly with varying arguments
+// and prints one tab-separated line:  name, calls, and nanoseconds per
+// call.  These are host cpu timings, not avr cycle counts:  the host
+// compiler, caches, and 32- or 64-bit arithmetic bear no fixed relation
+// to avr-gcc code on an 8-bit core, so the numbers only compare two
+// versions of the same function built the same way, and say nothing
+// about interrupt latency or time spent with interrupts disabled on
+// the clock.  Cycle counts need the firmware elf run under an avr
+// simulator such as simavr, which this program does not do.
+// (The firmware's time.h hides the system <time.h>, so the host clock
+// is read with hal_nanoseconds().)  Temperature compensation is
+// timed under the stub sensor configuration of temp_stub.h, unless
+// config.h enables a sensor.
+//
+// usage: hostbench [calls]
+//
+
+
+#include <stdint.h>       // for using standard integer types
+#include <stdio.h>        // for printing results
+#include <avr/io.h>       // for simulated registers
+#include <avr/pgmspace.h> // for PSTR()
+
+#include "hal.h"
+#include "config.h"
+#include "time.h"
+#include "display.h"
+#include "piezo.h"
+#include "temp_stub.h"
+#include "temp.h"
+#include "gps.h"
+
+
+#define BENCH_CALLS 1000000  // default calls per benchmark
+
+
+// defined in firmware modules, but not declared in headers
+void temp_calc_error(void);
+#ifdef GPS_TIMEKEEPING
+void USART_RX_vect(void);
+#endif  // GPS_TIMEKEEPING
+
+
+// keeps results from being optimized away
+static volatile uint8_t bench_sink;
+
+
+static void bench_dayofweek(uint32_t n) {
+    bench_sink = time_dayofweek(n % 100, n % 12 + 1, n % 28 + 1);
+}
+
+static void bench_isdst_usa(uint32_t n) {
+    time.month = n % 12 + 1;
+    time.day   = n % 28 + 1;
+    time.hour  = n % 24;
+    bench_sink = time_isdst_usa();
+}
+
+static void bench_isdst_eu(uint32_t n) {
+    time.month = n % 12 + 1;
+    time.day   = n % 28 + 1;
+    time.hour  = n % 24;
+    bench_sink = time_isdst_eu(n % 3);
+}
+
+static void bench_char(uint32_t n) {
+    display_char(n % DISPLAY_SIZE, ' ' + n % 96);
+}
+
+static void bench_pstr(uint32_t n) {
+    display_pstr(n & 1, PSTR("set alarm"));
+}
+
+static void bench_varsemitick(uint32_t n) {
+    bench_sink = display_varsemitick();
+}
+
+static void bench_buzzeron(uint32_t n) {
+    // octaves 3 to 6 of the twelve notes
+    piezo_buzzeron(((n / 12 % 4 + 3) << 12) | ((n % 12) << 8));
+}
+
+static void bench_calc_error(uint32_t n) {
+    temp.temp      = n % 1024;
+    temp.int_timer = n % 4096;
+    temp_calc_error();
+}
+
+#ifdef GPS_TIMEKEEPING
+// one byte of a valid rmc sentence per call
+static void bench_usart_rx(uint32_t n) {
+    static const char rmc[] =
+	"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,"
+	"003.1,W*6A\r\n";
+
+    UDR0 = rmc[n % (sizeof(rmc) - 1)];
+    USART_RX_vect();
+}
+#endif  // GPS_TIMEKEEPING
+
+
+// calls a benchmark and prints its timing
+static void bench_run(const char *name, void (*func)(uint32_t),
+		      uint32_t calls) {
+    uint64_t start = hal_nanoseconds();
+    for(uint32_t n = 0; n < calls; ++n) func(n);
+    uint64_t ns = hal_nanoseconds() - start;
+
+    printf("%s\t%lu\t%.1f\n", name, (unsigned long)calls,
+	    (double)ns / calls);
+}
+
+
+int main(int argc, char *argv[]) {
+    unsigned long calls = BENCH_CALLS;
+
+    if(argc > 2 || (argc == 2 && sscanf(argv[1], "%lu", &calls) != 1)) {
+	fprintf(stderr, "usage: hostbench [calls]\n");
+	return 1;
+    }
+
+    time_init();
+    display_init();
+    piezo_init();
+    temp_init();
+    gps_init();
+
+    bench_run("time_dayofweek",      bench_dayofweek,   calls);
+    bench_run("time_isdst_usa",      bench_isdst_usa,   calls);
+    bench_run("time_isdst_eu",       bench_isdst_eu,    calls);
+    bench_run("display_char",        bench_char,        calls);
+    bench_run("display_pstr",        bench_pstr,        calls);
+    bench_run("display_varsemitick", bench_varsemitick, calls);
+    bench_run("piezo_buzzeron",      bench_buzzeron,    calls);
+    bench_run("temp_calc_error",     bench_calc_error,  calls);
+#ifdef GPS_TIMEKEEPING
+    bench_run("USART_RX_vect",       bench_usart_rx,    calls);
+#endif  // GPS_TIMEKEEPING
+
+    return 0;
+}
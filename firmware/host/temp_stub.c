@@ -0,0 +1,15 @@
+// temp_stub.c  --  temp.c and time.c under the stub sensor configuration
+//
+// See temp_stub.h.  Programs link this file ahead of libicetube.a, so
+// these definitions replace those of the library's time.o.  When
+// config.h enables a sensor, the library modules are used as usual and
+// this file compiles to nothing.
+//
+
+
+#include "temp_stub.h"
+
+#ifdef TEMP_STUB
+#include "temp.c"
+#include "time.c"
+#endif  // TEMP_STUB
@@ -0,0 +1,25 @@
+// temp_stub.h  --  stub temperature sensor configuration for host programs
+//
+// Unless config.h enables TEMPERATURE_SENSOR, temp.c compiles to
+// nothing and temperature compensation cannot be benchmarked or
+// tested.  Host programs that exercise temp_calc_error() include this
+// file before temp.h, and link temp_stub.o, which compiles temp.c and
+// time.c (which applies the compensation) with the typical crystal
+// parameters from config.h.  If config.h already enables a sensor,
+// its configuration is used unchanged.
+//
+
+
+#ifndef HOST_TEMP_STUB_H
+#define HOST_TEMP_STUB_H
+
+#include "config.h"
+
+#ifndef TEMPERATURE_SENSOR
+#define TEMP_STUB
+#define TEMPERATURE_SENSOR
+#define XTAL_TURNOVER_TEMP  400  // deg C / 16
+#define XTAL_FREQUENCY_COEF 34   // -ppb / (deg C)^2
+#endif  // ~TEMPERATURE_SENSOR
+
+#endif  // HOST_TEMP_STUB_H
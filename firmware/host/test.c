@@ -0,0 +1,573 @@
+// test.c  --  checks firmware modules on the host
+//
+// Each test sets up simulated state, calls firmware functions, and
+// checks the results.  A failed check prints its file, line, and
+// expression; the runner prints one line per test and exits with
+// status 1 if any check failed.
+//
+// usage: test
+//
+
+
+#include <stdint.h>       // for using standard integer types
+#include <stdio.h>        // for printing results
+#include <math.h>         // for fabs()
+#include <avr/io.h>       // for simulated registers
+#include <avr/eeprom.h>   // for reading simulated eeprom
+
+#include "hal.h"
+#include "config.h"
+#include "time.h"
+#include "temp_stub.h"
+#include "temp.h"
+#include "buttons.h"
+#include "display.h"
+#include "mode.h"
+
+
+// defined in temp.c, but not declared in temp.h
+void temp_calc_error(void);
+
+// defined in mode.c, but not declared in mode.h
+extern const mode_menu_t mode_menus[MODE_MENU_COUNT];
+extern const mode_edit_t mode_edits[MODE_EDIT_COUNT];
+void mode_update(uint8_t new_state, uint8_t disp_trans);
+void mode_edit_process(uint8_t state, uint8_t btn);
+
+// defined in time.c
+extern uint8_t ee_time_year, ee_time_month, ee_time_day;
+extern uint8_t ee_time_hour, ee_time_minute, ee_time_second;
+extern uint8_t ee_time_slot[TIME_SLOT_SIZE];
+
+
+typedef struct {
+    uint32_t checks;    // checks made
+    uint32_t failures;  // checks failed
+} test_t;
+
+
+static test_t test;
+
+
+// counts a check and reports it if it failed
+#define TEST_CHECK(expr) test_check((expr), #expr, __FILE__, __LINE__)
+
+static void test_check(int passed, const char *expr,
+		       const char *file, int line) {
+    ++test.checks;
+
+    if(!passed) {
+	++test.failures;
+	printf("%s:%d: check failed: %s\n", file, line, expr);
+    }
+}
+
+
+// sets the time directly, without drift correction or dst
+static void test_settime(uint8_t year, uint8_t month, uint8_t day,
+			 uint8_t hour, uint8_t minute, uint8_t second) {
+    time.status = 0;
+    time.year   = year;
+    time.month  = month;
+    time.day    = day;
+    time.hour   = hour;
+    time.minute = minute;
+    time.second = second;
+    time.lazy_due     = 0;
+    time.lazy_seconds = 0;
+}
+
+
+// returns true if the time is as given
+static uint8_t test_istime(uint8_t year, uint8_t month, uint8_t day,
+			   uint8_t hour, uint8_t minute, uint8_t second) {
+    return time.year == year && time.month == month && time.day == day
+	&& time.hour == hour && time.minute == minute
+	&& time.second == second;
+}
+
+
+// returns seconds since 2000 of the current time
+static uint32_t test_seconds(void) {
+    uint32_t days = time.year * 365UL + (time.year + 3) / 4;
+
+    for(uint8_t month = TIME_JAN; month < time.month; ++month) {
+	days += time_daysinmonth(time.year, month);
+    }
+    days += time.day - 1;
+
+    return ((days * 24 + time.hour) * 60 + time.minute) * 60 + time.second;
+}
+
+
+static void test_calendar(void) {
+    TEST_CHECK(time_daysinmonth(0,  TIME_FEB) == 29);  // 2000
+    TEST_CHECK(time_daysinmonth(26, TIME_FEB) == 28);
+    TEST_CHECK(time_daysinmonth(28, TIME_FEB) == 29);
+    TEST_CHECK(time_daysinmonth(26, TIME_APR) == 30);
+    TEST_CHECK(time_daysinmonth(26, TIME_DEC) == 31);
+
+    TEST_CHECK(time_dayofweek(0,  TIME_JAN, 1)  == TIME_SAT);
+    TEST_CHECK(time_dayofweek(0,  TIME_MAR, 1)  == TIME_WED);
+    TEST_CHECK(time_dayofweek(24, TIME_FEB, 29) == TIME_THU);
+    TEST_CHECK(time_dayofweek(26, TIME_OCT, 18) == TIME_SUN);
+    TEST_CHECK(time_dayofweek(99, TIME_DEC, 31) == TIME_THU);
+}
+
+
+static void test_tick(void) {
+    time_init();
+
+    test_settime(23, TIME_DEC, 31, 23, 59, 59);
+    time_tick();
+    TEST_CHECK(test_istime(24, TIME_JAN, 1, 0, 0, 0));
+    TEST_CHECK(eeprom_read_byte(&ee_time_year)  == 24);
+    TEST_CHECK(eeprom_read_byte(&ee_time_month) == TIME_JAN);
+    TEST_CHECK(eeprom_read_byte(&ee_time_day)   == 1);
+
+    test_settime(24, TIME_FEB, 28, 23, 59, 59);
+    time_tick();
+    TEST_CHECK(test_istime(24, TIME_FEB, 29, 0, 0, 0));
+
+    test_settime(26, TIME_FEB, 28, 23, 59, 59);
+    time_tick();
+    TEST_CHECK(test_istime(26, TIME_MAR, 1, 0, 0, 0));
+
+    // seconds deferred during sleep are added at the next hour
+    test_settime(26, TIME_JUN, 30, 23, 58, 30);
+    time.lazy_due = time_nexthour();
+    TEST_CHECK(time.lazy_due == 90);
+    for(uint8_t i = 0; i < 89; ++i) time_tick();
+    TEST_CHECK(test_istime(26, TIME_JUN, 30, 23, 58, 30));
+    time_tick();
+    TEST_CHECK(test_istime(26, TIME_JUL, 1, 0, 0, 0));
+
+    // adding seconds at once matches adding them one at a time
+    static const uint32_t counts[] = { 1, 59, 60, 3599, 86400, 2678400 };
+    for(uint8_t i = 0; i < sizeof(counts) / sizeof(*counts); ++i) {
+	for(uint8_t lazy = 0; lazy < 2; ++lazy) {
+	    test_settime(24, TIME_FEB, 28, 23, 58, 30);
+	    if(lazy) time.lazy_due = time_nexthour();
+	    for(uint32_t s = 0; s < counts[i]; ++s) time_tick();
+	    time_normalize();
+	    uint32_t each = test_seconds();
+
+	    test_settime(24, TIME_FEB, 28, 23, 58, 30);
+	    if(lazy) time.lazy_due = time_nexthour();
+	    time_addseconds(counts[i]);
+	    time_normalize();
+	    TEST_CHECK(test_seconds() == each);
+	}
+    }
+}
+
+
+static void test_dst(void) {
+    // 2026:  usa dst from mar 8 to nov 1; eu dst from mar 29 to oct 25
+    test_settime(26, TIME_MAR, 8, 1, 59, 59);
+    TEST_CHECK(!time_isdst_usa());
+    time.hour = 2;
+    TEST_CHECK(time_isdst_usa());
+    time.day = 7;
+    TEST_CHECK(!time_isdst_usa());
+
+    test_settime(26, TIME_NOV, 1, 0, 59, 59);
+    TEST_CHECK(time_isdst_usa());
+    time.hour = 2;
+    TEST_CHECK(!time_isdst_usa());
+
+    test_settime(26, TIME_MAR, 29, 0, 59, 59);
+    TEST_CHECK(!time_isdst_eu(0));
+    time.hour = 1;
+    TEST_CHECK(time_isdst_eu(0));
+    TEST_CHECK(!time_isdst_eu(1));
+
+    test_settime(26, TIME_OCT, 25, 1, 0, 0);
+    time.status = TIME_DST;
+    TEST_CHECK(time_isdst_eu(0));
+    time.hour = 2;
+    TEST_CHECK(!time_isdst_eu(0));
+
+    // automatic dst moves the clock at the change
+    test_settime(26, TIME_MAR, 8, 1, 59, 59);
+    time.status = TIME_AUTODST_USA;
+    time_tick();
+    TEST_CHECK(test_istime(26, TIME_MAR, 8, 3, 0, 0));
+    TEST_CHECK(time.status & TIME_DST);
+}
+
+
+static void test_powerfail(void) {
+    time_init();
+
+    // time saved on power failure is restored on reset
+    test_settime(26, TIME_OCT, 18, 12, 34, 56);
+    time_sleep();
+    test_settime(0, TIME_JAN, 1, 0, 0, 0);
+    time_init();
+    TEST_CHECK(test_istime(26, TIME_OCT, 18, 12, 34, 56));
+
+    // the slot is erased on wake, when the time is saved normally
+    time.hour = 13;
+    time_wake();
+    for(uint8_t i = 0; i < TIME_SLOT_SIZE; ++i) {
+	TEST_CHECK(eeprom_read_byte(&ee_time_slot[i]) == 0xFF);
+    }
+    test_settime(0, TIME_JAN, 1, 0, 0, 0);
+    time_init();
+    TEST_CHECK(test_istime(26, TIME_OCT, 18, 13, 34, 56));
+
+    // a slot left unerased by an interrupted wake is not restored,
+    // whether or not its valid byte was erased
+    for(uint8_t valid = 0; valid < 2; ++valid) {
+	test_settime(26, TIME_OCT, 18, 14, 0, 0);
+	time_wake();
+	ee_time_slot[TIME_SLOT_MINUTE] = 0x0F;
+	if(valid) ee_time_slot[TIME_SLOT_VALID] = 0;
+
+	test_settime(26, TIME_OCT, 18, 14, 30, 0);
+	time_sleep();
+	TEST_CHECK(eeprom_read_byte(&ee_time_slot[TIME_SLOT_VALID]) == 0xFF);
+	test_settime(0, TIME_JAN, 1, 0, 0, 0);
+	time_init();
+	TEST_CHECK(test_istime(26, TIME_OCT, 18, 14, 0, 0));
+    }
+}
+
+
+// returns the error accumulated by temperature compensation since
+// the given time [2^-32 of 1/128 seconds]; whole seconds are added
+// to the time, and the remainder is kept in temp.adjust and temp.error
+static uint64_t test_compensation(uint32_t start) {
+    uint64_t ticks = (uint64_t)(test_seconds() - start) * 128 + temp.adjust;
+    return (ticks << 32) + temp.error;
+}
+
+
+// checks temperature compensation of one interval against
+// 64-bit and floating point calculations of the same error
+static void test_calc_error_at(int16_t t, uint32_t interval) {
+    test_settime(26, TIME_JAN, 1, 0, 0, 0);
+    uint32_t start = test_seconds();
+
+    temp.temp      = t;
+    temp.int_timer = interval;
+    temp.adjust    = 0;
+    temp.error     = 0;
+    temp_calc_error();
+
+    uint64_t error = test_compensation(start);
+
+    // rate as documented, saturating at 32 bits [2^-36 of 1/128 seconds]
+    int32_t  delta = XTAL_TURNOVER_TEMP - t;
+    uint64_t rate  = (uint64_t)(delta * delta) * TEMP_ERROR_COEF;
+    if(rate > UINT32_MAX) rate = UINT32_MAX;
+
+    TEST_CHECK(error == (rate * interval) >> 4);
+
+    // within sensor range, the only error is from rounding TEMP_ERROR_COEF
+    // and from truncating to 2^-32 of 1/128 seconds
+    if(-55 * 16 <= t && t <= 125 * 16) {
+	double exact = XTAL_FREQUENCY_COEF * 1e-9 * 128
+		     * (delta / 16.0) * (delta / 16.0) * interval;
+	double actual = error / 4294967296.0;
+
+	TEST_CHECK(fabs(actual - exact)
+		   <= exact * 0.5 / (TEMP_ERROR_COEF - 0.5) + 1e-9);
+    }
+}
+
+
+// returns the error in 1/128 seconds computed for one interval by
+// temp_calc_error() as it was before constant-time compensation; the
+// baseline rounds to whole degrees for intervals of 300 seconds or more
+// and its 32-bit products only hold for moderate temperatures
+static double test_baseline_error(int16_t t, uint32_t interval) {
+    int32_t  error;
+    uint32_t adjust = 0;
+    uint32_t remain;
+
+    if(interval < 300) {
+	error  = XTAL_TURNOVER_TEMP - t;
+	error *= error;
+	error *= XTAL_FREQUENCY_COEF;
+	error *= interval;
+	remain = error;
+    } else {
+	error  = (XTAL_TURNOVER_TEMP - (t + 0x08)) >> 4;
+	error *= error;
+	error *= XTAL_FREQUENCY_COEF;
+	error *= interval;
+	while(error > (1000000000UL >> 7)) {
+	    ++adjust;
+	    error -= (1000000000UL >> 7);
+	}
+	remain = error << 8;
+    }
+
+    // 2e9 units of the baseline's error are 1/128 seconds
+    return adjust + remain / 2e9;
+}
+
+
+// checks temperature compensation against the baseline algorithm
+static void test_calc_error_baseline(int16_t t, uint32_t interval) {
+    test_settime(26, TIME_JAN, 1, 0, 0, 0);
+    uint32_t start = test_seconds();
+
+    temp.temp      = t;
+    temp.int_timer = interval;
+    temp.adjust    = 0;
+    temp.error     = 0;
+    temp_calc_error();
+
+    double actual   = test_compensation(start) / 4294967296.0;
+    double baseline = test_baseline_error(t, interval);
+
+    // besides rounding TEMP_ERROR_COEF, short intervals differ only by
+    // truncation; for long intervals the baseline truncates delta less
+    // half a degree, which is off by up to 1.5 degrees, so it differs by
+    // up to (|d| + 3/2)^2 - d^2 = 3|d| + 9/4
+    double d     = fabs(XTAL_TURNOVER_TEMP - t) / 16.0;
+    double round = (interval < 300 ? 0 : 3 * d + 2.25)
+		 * XTAL_FREQUENCY_COEF * 1e-9 * 128 * interval;
+    double bound = baseline * 0.5 / (TEMP_ERROR_COEF - 0.5)
+		 + round + 1e-6;
+
+    TEST_CHECK(fabs(actual - baseline) <= bound);
+}
+
+
+static void test_calc_error(void) {
+    static const uint32_t intervals[] = {
+	0, 1, 2, 15, 16, 64, 299, 300, 301, 4095, 65535, 65536, 65537,
+	86400, 1UL << 20, 31557600, INT32_MAX,
+    };
+    static const int16_t extremes[] = {
+	INT16_MIN + XTAL_TURNOVER_TEMP, -20000, -2000, 3000, 20000,
+	TEMP_INVALID - 1,
+    };
+
+    time_init();
+    temp_init();
+
+    // whole sensor range; against the baseline, only where its
+    // 32-bit products do not overflow (0 to 50 deg C, 65535 seconds)
+    for(uint8_t i = 0; i < sizeof(intervals) / sizeof(*intervals); ++i) {
+	for(int16_t t = -55 * 16; t <= 125 * 16; ++t) {
+	    test_calc_error_at(t, intervals[i]);
+	    if(0 <= t && t <= 50 * 16 && intervals[i] <= 65535) {
+		test_calc_error_baseline(t, intervals[i]);
+	    }
+	}
+
+	for(uint8_t j = 0; j < sizeof(extremes) / sizeof(*extremes); ++j) {
+	    test_calc_error_at(extremes[j], intervals[i] % 100000);
+	}
+    }
+
+    // fractions carry:  an hour of one-second readings matches a
+    // single hour-long reading, less the truncation of each reading
+    test_settime(26, TIME_JAN, 1, 0, 0, 0);
+    uint32_t start = test_seconds();
+
+    test_calc_error_at(60 * 16, 3600);
+    uint64_t once = test_compensation(start);
+
+    test_settime(26, TIME_JAN, 1, 0, 0, 0);
+    temp.adjust = 0;
+    temp.error  = 0;
+    for(uint16_t i = 0; i < 3600; ++i) {
+	temp.int_timer = 1;
+	temp_calc_error();
+    }
+    uint64_t each = test_compensation(start);
+
+    TEST_CHECK(each <= once && once - each < 3600);
+}
+
+
+#ifdef AUTOMATIC_DIMMER
+static void test_autodim(void) {
+    // brightness follows the linear mapping of photoresistor voltage
+    // to the brightness range; photo_idx starts above any result, so
+    // the one-index lag always adds one
+    for(int8_t min = -5; min <= 9; ++min) {
+	for(int8_t max = min; max <= 20; ++max) {
+	    display.bright_min = min;
+	    display.bright_max = max;
+
+	    for(uint32_t avg = 0; avg <= UINT16_MAX; avg += 0x55) {
+		int16_t expected = (max << 3)
+				 - (((avg >> 8) * (max - min)) >> 5);
+		display.photo_avg = avg;
+		display.photo_idx = INT16_MAX;
+		display_autodim();
+		TEST_CHECK(display.photo_idx == expected + 1);
+	    }
+	}
+    }
+
+    display_loadbright();
+}
+#endif  // AUTOMATIC_DIMMER
+
+
+static void test_mode(void) {
+    // every menu and value state has an entry in its table
+    for(uint8_t i = 0; i < MODE_MENU_COUNT; ++i) {
+	TEST_CHECK(mode_menus[i].label[0]);
+    }
+    for(uint8_t i = 0; i < MODE_EDIT_COUNT; ++i) {
+	TEST_CHECK(mode_edits[i].value
+		   && mode_edits[i].min < mode_edits[i].max);
+    }
+
+    // values wrap at the end of their range, days at the end of the
+    // month being set, and the set button saves them
+    time_init();
+    mode.tmp[MODE_TMP_YEAR]  = 24;
+    mode.tmp[MODE_TMP_MONTH] = TIME_FEB;
+    mode.tmp[MODE_TMP_DAY]   = 28;
+    mode_update(MODE_SETDATE_DAY, DISPLAY_TRANS_INSTANT);
+
+    mode_edit_process(MODE_SETDATE_DAY, BUTTONS_PLUS);
+    TEST_CHECK(mode.tmp[MODE_TMP_DAY] == 29);
+    mode_edit_process(MODE_SETDATE_DAY, BUTTONS_PLUS);
+    TEST_CHECK(mode.tmp[MODE_TMP_DAY] == 1);
+    TEST_CHECK(mode.state == MODE_SETDATE_DAY);
+
+    mode_edit_process(MODE_SETDATE_DAY, BUTTONS_SET);
+    TEST_CHECK(mode.state == MODE_TIME_DISPLAY);
+    TEST_CHECK(time.year == 24 && time.month == TIME_FEB && time.day == 1);
+    TEST_CHECK(eeprom_read_byte(&ee_time_month) == TIME_FEB);
+
+    mode.tmp[MODE_TMP_HOUR] = 23;
+    mode_update(MODE_SETTIME_HOUR, DISPLAY_TRANS_INSTANT);
+    mode_edit_process(MODE_SETTIME_HOUR, BUTTONS_PLUS);
+    TEST_CHECK(mode.tmp[MODE_TMP_HOUR] == 0);
+    mode_edit_process(MODE_SETTIME_HOUR, BUTTONS_SET);
+    TEST_CHECK(mode.state == MODE_SETTIME_MINUTE);
+    mode_edit_process(MODE_SETTIME_MINUTE, BUTTONS_MENU);
+    TEST_CHECK(mode.state == MODE_TIME_DISPLAY);
+}
+
+
+#if !defined(XMAS_DESIGN) && !defined(VFD_TO_SPEC)
+// sets the button pins as pressed, holds them for the given
+// semiseconds, then raises a pin change; the menu and plus buttons
+// are on PD5 and PD4, and the set button is on PB0
+static void test_buttons_hold(uint8_t pressed, uint16_t semiseconds) {
+    PIND = ~((pressed & BUTTONS_MENU ? _BV(PD5) : 0)
+	     | (pressed & BUTTONS_PLUS ? _BV(PD4) : 0));
+    PINB = ~(pressed & BUTTONS_SET ? _BV(PB0) : 0);
+    buttons_pcint();
+
+    while(semiseconds--) buttons_semitick();
+}
+
+
+static void test_buttons(void) {
+    buttons_wake();
+    test_buttons_hold(0, BUTTONS_DEBOUNCE_TIME);
+
+    // without chords, a press is reported on the first edge
+    buttons.chord_hold = 0;
+    test_buttons_hold(BUTTONS_SET, 0);
+    TEST_CHECK(buttons_event() == (BUTTONS_PRESS | BUTTONS_SET));
+    test_buttons_hold(BUTTONS_SET, BUTTONS_DEBOUNCE_TIME);
+    test_buttons_hold(0, BUTTONS_DEBOUNCE_TIME);
+    TEST_CHECK(buttons_event() == (BUTTONS_RELEASE | BUTTONS_SET));
+    TEST_CHECK(buttons_event() == 0);
+
+    // events queued while they cannot be processed do not replay;
+    // only the latest press of held buttons is kept
+    for(uint8_t held = 0; held < 2; ++held) {
+	for(uint8_t i = 0; i < 3; ++i) {
+	    test_buttons_hold(BUTTONS_PLUS, BUTTONS_DEBOUNCE_TIME);
+	    test_buttons_hold(0, BUTTONS_DEBOUNCE_TIME);
+	}
+	if(held) test_buttons_hold(BUTTONS_MENU, BUTTONS_DEBOUNCE_TIME);
+	buttons_coalesce();
+	if(held) {
+	    TEST_CHECK(buttons_event() == (BUTTONS_PRESS | BUTTONS_MENU));
+	    test_buttons_hold(0, BUTTONS_DEBOUNCE_TIME);
+	    buttons_event();
+	}
+	TEST_CHECK(buttons_event() == 0);
+    }
+
+    // with chords, buttons pressed together, within and after the
+    // debounce time, are a single press
+    buttons.chord_hold = 1;
+    static const uint8_t apart[] = { 5, BUTTONS_DEBOUNCE_TIME + 10 };
+    for(uint8_t i = 0; i < sizeof(apart) / sizeof(*apart); ++i) {
+	test_buttons_hold(BUTTONS_SET, apart[i]);
+	test_buttons_hold(BUTTONS_SET | BUTTONS_PLUS, 200);
+	test_buttons_hold(0, 200);
+	TEST_CHECK(buttons_event() == (BUTTONS_PRESS | BUTTONS_SET
+						     | BUTTONS_PLUS));
+	TEST_CHECK(buttons_event() == (BUTTONS_RELEASE | BUTTONS_SET
+						       | BUTTONS_PLUS));
+	TEST_CHECK(buttons_event() == 0);
+    }
+
+    // a tap shorter than the chord time is still a press
+    test_buttons_hold(BUTTONS_MENU, BUTTONS_DEBOUNCE_TIME + 5);
+    test_buttons_hold(0, 200);
+    TEST_CHECK(buttons_event() == (BUTTONS_PRESS   | BUTTONS_MENU));
+    TEST_CHECK(buttons_event() == (BUTTONS_RELEASE | BUTTONS_MENU));
+    TEST_CHECK(buttons_event() == 0);
+
+    // a button added after the chord time is a chord
+    test_buttons_hold(BUTTONS_MENU, BUTTONS_CHORD_TIME + 10);
+    test_buttons_hold(BUTTONS_MENU | BUTTONS_PLUS, 200);
+    test_buttons_hold(0, 200);
+    TEST_CHECK(buttons_event() == (BUTTONS_PRESS | BUTTONS_MENU));
+    TEST_CHECK(buttons_event() == (BUTTONS_CHORD | BUTTONS_MENU
+						 | BUTTONS_PLUS));
+    TEST_CHECK(buttons_event() == (BUTTONS_RELEASE | BUTTONS_MENU
+						   | BUTTONS_PLUS));
+    TEST_CHECK(buttons_event() == 0);
+
+    buttons.chord_hold = 0;
+}
+#endif  // ~XMAS_DESIGN && ~VFD_TO_SPEC
+
+
+// runs a test and prints whether it passed
+static void test_run(const char *name, void (*func)(void)) {
+    uint32_t failures = test.failures;
+
+    func();
+
+    printf("%-20s %s\n", name, test.failures == failures ? "ok" : "FAILED");
+}
+
+
+int main(int argc, char *argv[]) {
+    if(argc > 1) {
+	fprintf(stderr, "usage: test\n");
+	return 1;
+    }
+
+    UCSR0A = _BV(UDRE0);  // usart is always ready to transmit
+
+    test_run("time_calendar",  test_calendar);
+    test_run("time_tick",      test_tick);
+    test_run("time_dst",       test_dst);
+    test_run("time_powerfail", test_powerfail);
+    test_run("temp_calc_error", test_calc_error);
+#ifdef AUTOMATIC_DIMMER
+    test_run("display_autodim", test_autodim);
+#endif  // AUTOMATIC_DIMMER
+    test_run("mode_edit",      test_mode);
+#if !defined(XMAS_DESIGN) && !defined(VFD_TO_SPEC)
+    test_run("buttons_chord",  test_buttons);
+#endif  // ~XMAS_DESIGN && ~VFD_TO_SPEC
+
+    printf("%lu checks, %lu failed\n",
+	    (unsigned long)test.checks, (unsigned long)test.failures);
+
+    return test.failures ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+// atomic.h  --  host replacement for <util/atomic.h>
+//
+// Like avr-libc, blocks clear or set the simulated global interrupt
+// flag in SREG and restore it when the block is left.
+//
+
+
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <avr/io.h>         // for SREG
+#include <avr/interrupt.h>  // for cli() and sei(), as with avr-libc
+
+
+static inline uint8_t hal_cli_ret(void) { SREG &= ~_BV(7); return 1; }
+static inline uint8_t hal_sei_ret(void) { SREG |=  _BV(7); return 1; }
+
+static inline void hal_sei_param(const uint8_t *s) { (void)s; SREG |= _BV(7); }
+static inline void hal_cli_param(const uint8_t *s) { (void)s; SREG &= ~_BV(7); }
+static inline void hal_restore(const uint8_t *s)   { SREG = *s; }
+
+#define ATOMIC_BLOCK(type) \
+    for(type, hal_todo = hal_cli_ret(); hal_todo; hal_todo = 0)
+
+#define NONATOMIC_BLOCK(type) \
+    for(type, hal_todo = hal_sei_ret(); hal_todo; hal_todo = 0)
+
+#define ATOMIC_RESTORESTATE \
+    uint8_t hal_sreg __attribute__((__cleanup__(hal_restore))) = SREG
+#define ATOMIC_FORCEON \
+    uint8_t hal_sreg __attribute__((__cleanup__(hal_sei_param))) = 0
+
+#define NONATOMIC_RESTORESTATE \
+    uint8_t hal_sreg __attribute__((__cleanup__(hal_restore))) = SREG
+#define NONATOMIC_FORCEOFF \
+    uint8_t hal_sreg __attribute__((__cleanup__(hal_cli_param))) = 0
+
+#endif  // HOST_UTIL_ATOMIC_H
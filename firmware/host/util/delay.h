@@ -0,0 +1,13 @@
+// delay.h  --  host replacement for <util/delay.h>
+//
+// Busy-wait delays take no time on the host.
+//
+
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#define _delay_ms(ms) do { (void)(ms); } while(0)
+#define _delay_us(us) do { (void)(us); } while(0)
+
+#endif  // HOST_UTIL_DELAY_H
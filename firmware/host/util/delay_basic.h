@@ -0,0 +1,13 @@
+// delay_basic.h  --  host replacement for <util/delay_basic.h>
+//
+// Busy-wait loops take no time on the host.
+//
+
+
+#ifndef HOST_UTIL_DELAY_BASIC_H
+#define HOST_UTIL_DELAY_BASIC_H
+
+#define _delay_loop_1(count) do { (void)(count); } while(0)
+#define _delay_loop_2(count) do { (void)(count); } while(0)
+
+#endif  // HOST_UTIL_DELAY_BASIC_H
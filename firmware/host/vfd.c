@@ -0,0 +1,638 @@
+// vfd.c  --  runs the firmware on the host and decodes the display
+//
+// The firmware is started as on the clock, and each sleep_cpu() in the
+// idle loop advances simulated time by one timer0 overflow (32 us at
+// 8 MHz).  In power-save mode, sleep_cpu() advances time until the
+// timer2 interrupt, the watchdog interrupt, or a pin change interrupt
+// raised by the script wakes the processor.  Writes to the MAX6921
+// pins are decoded into 20-bit words, and the latched words are
+// rendered as seven-segment text frames.  A frame is printed whenever
+// the segments lit during a frame period change, so transition
+// animations appear as a series of frames.
+// Per-digit refresh rate and on-time are reported at the end.
+// Simulated time advances only where the firmware sleeps, and
+// interrupts are called between firmware statements rather than
+// at arbitrary instructions (see hal.c), so scenarios check display
+// output and state changes, not real-time behavior on the clock.
+//
+// usage: vfd [-c capture] seconds [script]
+//
+// With -c, MAX6921 pin changes are also written to the capture file
+// as "seconds,din,clk,load,blank" lines for analysis by duty.
+//
+// Each script line is "<seconds> <action>", in order of time, where
+// action is one of:
+//
+//    pin <port><bit> <0|1>   set an input pin (e.g. "pin D5 0" presses
+//                            the menu button) and raise its pin change
+//                            interrupt
+//    light <value>           set the photoresistor adc value
+//    power <0|1>             cut (0) or restore (1) adaptor power
+//    gps <sentence>          receive an nmea sentence from the gps
+//    expect "<text>"         check the last printed frame, one
+//                            character per digit; "?" matches any
+//                            digit, and decimal points are ignored
+//
+// Lines starting with "#" are ignored.  Failed expectations are
+// printed to stderr, and vfd exits with status 1 if any failed.
+//
+
+
+#include <stdint.h>       // for using standard integer types
+#include <stdio.h>        // for reading scripts and printing frames
+#include <stdlib.h>       // for exit() and strtod()
+#include <string.h>       // for memcmp(), memcpy(), and strlen()
+#include <unistd.h>       // for getopt()
+#include <avr/io.h>       // for simulated registers
+#include <avr/pgmspace.h> // for pgm_read_byte()
+#include <avr/sleep.h>    // for SLEEP_MODE_PWR_SAVE
+
+#include "hal.h"
+#include "config.h"
+#include "display.h"
+
+
+// simulation parameters
+#define VFD_OVERFLOW_US   32       // microseconds per timer0 overflow
+#define VFD_SECOND_US     1000000  // microseconds per second
+#define VFD_XTAL_HZ       32768    // timer2 crystal frequency
+#define VFD_WDT_US        64000    // watchdog interrupt timeout
+#define VFD_FRAME_US      20000    // frame period (microseconds)
+#define VFD_SCRIPT_SIZE   256      // maximum script lines
+#define VFD_TEXT_SIZE     84       // gps sentence or expected text
+
+// segment flags (as in display.c)
+#define VFD_SEG_A 0x80
+#define VFD_SEG_B 0x40
+#define VFD_SEG_C 0x20
+#define VFD_SEG_D 0x10
+#define VFD_SEG_E 0x08
+#define VFD_SEG_F 0x04
+#define VFD_SEG_G 0x02
+#define VFD_SEG_H 0x01
+
+// MAX6921 pins used by the display
+#define VFD_DIN_PORT   HAL_PORTB
+#define VFD_DIN_BIT    PB3
+#define VFD_CLK_PORT   HAL_PORTB
+#define VFD_CLK_BIT    PB5
+#define VFD_LOAD_PORT  HAL_PORTC
+#define VFD_LOAD_BIT   PC0
+#ifdef VFD_TO_SPEC
+// pwm on the blank pin is not simulated
+#define VFD_BLANK_PORT HAL_PORTD
+#define VFD_BLANK_BIT  PD5
+#else
+#define VFD_BLANK_PORT HAL_PORTC
+#define VFD_BLANK_BIT  PC3
+#endif  // VFD_TO_SPEC
+#ifndef XMAS_DESIGN
+// MAX6921 power (off when high) is not switched on the xmas design
+#define VFD_POWER_PORT HAL_PORTD
+#define VFD_POWER_BIT  PD3
+#endif  // ~XMAS_DESIGN
+
+// multiplexing algorithm, recorded in captures
+#if defined(SUBDIGIT_MULTIPLEXING)
+#define VFD_MULTIPLEXING "SUBDIGIT_MULTIPLEXING"
+#elif defined(SEGMENT_MULTIPLEXING)
+#define VFD_MULTIPLEXING "SEGMENT_MULTIPLEXING"
+#else
+#define VFD_MULTIPLEXING "DIGIT_MULTIPLEXING"
+#endif
+
+
+// script actions
+enum { VFD_PIN, VFD_LIGHT, VFD_POWER, VFD_GPS, VFD_EXPECT };
+
+
+// defined in icetube.c (main() is renamed for host builds)
+int firmware_main(void);
+void TIMER0_OVF_vect(void);
+void TIMER2_COMPB_vect(void);
+void PCINT0_vect(void);
+void PCINT2_vect(void);
+void ADC_vect(void);
+void ANALOG_COMP_vect(void);
+
+// defined in system.c and gps.c
+void WDT_vect(void);
+#ifdef GPS_TIMEKEEPING
+void USART_RX_vect(void);
+#endif  // GPS_TIMEKEEPING
+
+// defined in display.c
+extern const uint8_t vfd_digit_pins[];
+extern const uint8_t vfd_segment_pins[];
+extern const uint8_t number_segments[];
+extern const uint8_t letter_segments_ada[];
+extern const uint8_t letter_segments_alt[];
+
+
+typedef struct {
+    uint32_t time;    // microseconds
+    uint8_t type;     // VFD_PIN, VFD_LIGHT, VFD_POWER, ...
+    char port;        // 'B', 'C', or 'D'
+    uint8_t bit;      // pin number
+    uint16_t value;   // pin level, adc value, or power state
+    char text[VFD_TEXT_SIZE];  // gps sentence or expected text
+} vfd_action_t;
+
+
+typedef struct {
+    uint32_t now;        // simulated time (microseconds)
+    uint32_t end;        // end of simulation (microseconds)
+    uint32_t overflows;  // timer0 overflows since start
+    uint32_t timer2_due; // time of next timer2 interrupt
+    uint32_t wdt_due;    // time of next watchdog interrupt or zero
+    uint32_t wakes;      // pin change interrupts raised by the script
+
+    vfd_action_t script[VFD_SCRIPT_SIZE];
+    uint16_t script_len;
+    uint16_t script_idx;
+    uint16_t light;      // adc value returned for conversions
+    uint32_t expects;    // expectations checked
+    uint32_t failures;   // expectations failed
+
+    uint8_t ports[HAL_PORTS];  // last reported port values
+    uint32_t shift;      // MAX6921 shift register
+    uint32_t latch;      // MAX6921 latched outputs
+    uint8_t blank;       // MAX6921 blank pin
+    uint8_t off;         // MAX6921 power pin
+
+    uint32_t changed;    // time of last latch or blank change
+    uint32_t frame_start;
+    uint8_t frame[DISPLAY_SIZE];   // segments lit in current frame
+    uint8_t shown[DISPLAY_SIZE];   // segments of last printed frame
+    uint32_t frames;     // frames printed
+    FILE *capture;       // pin change capture or NULL
+
+    uint32_t on_time[DISPLAY_SIZE];  // digit unblanked (microseconds)
+    uint32_t refreshes[DISPLAY_SIZE];  // times digit was lit
+} vfd_t;
+
+
+static vfd_t vfd;
+
+
+// returns the display index driven by a MAX6921 output or -1
+static int8_t vfd_digit(uint8_t pin) {
+    for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	if(pgm_read_byte(&vfd_digit_pins[idx]) == pin) return idx;
+    }
+
+    return -1;
+}
+
+
+// returns the segment flag driven by a MAX6921 output or zero
+static uint8_t vfd_segment(uint8_t pin) {
+    for(uint8_t seg = 0; seg < 8; ++seg) {
+	if(pgm_read_byte(&vfd_segment_pins[seg]) == pin) return _BV(seg);
+    }
+
+    return 0;
+}
+
+
+// credits the latched word with the time since the last change
+static void vfd_account(void) {
+    uint32_t elapsed = vfd.now - vfd.changed;
+    vfd.changed = vfd.now;
+
+    if(vfd.blank || vfd.off || !elapsed) return;
+
+    uint8_t segments = 0;
+    for(uint8_t pin = 0; pin < 20; ++pin) {
+	if(vfd.latch & (1UL << pin)) segments |= vfd_segment(pin);
+    }
+
+    for(uint8_t pin = 0; pin < 20; ++pin) {
+	int8_t idx = vfd_digit(pin);
+	if(idx < 0 || !(vfd.latch & (1UL << pin))) continue;
+
+	vfd.on_time[idx]  += elapsed;
+	vfd.frame[idx]    |= segments;
+    }
+}
+
+
+// counts digits that are lit by the latched word
+static void vfd_refresh(void) {
+    if(vfd.blank || vfd.off) return;
+
+    for(uint8_t pin = 0; pin < 20; ++pin) {
+	int8_t idx = vfd_digit(pin);
+	if(idx >= 0 && (vfd.latch & (1UL << pin))) ++vfd.refreshes[idx];
+    }
+}
+
+
+// writes MAX6921 pin levels to the capture file
+static void vfd_capture(void) {
+    static uint8_t prev = 0xFF;
+    uint8_t pins =  (vfd.ports[VFD_DIN_PORT]   & _BV(VFD_DIN_BIT)   ? 8 : 0)
+		  | (vfd.ports[VFD_CLK_PORT]   & _BV(VFD_CLK_BIT)   ? 4 : 0)
+		  | (vfd.ports[VFD_LOAD_PORT]  & _BV(VFD_LOAD_BIT)  ? 2 : 0)
+		  | (vfd.ports[VFD_BLANK_PORT] & _BV(VFD_BLANK_BIT) ? 1 : 0);
+
+    if(pins == prev) return;
+    prev = pins;
+
+    fprintf(vfd.capture, "%.6f,%u,%u,%u,%u\n", vfd.now / 1e6,
+	    (pins >> 3) & 1, (pins >> 2) & 1, (pins >> 1) & 1, pins & 1);
+}
+
+
+// decodes MAX6921 pin changes
+static void vfd_port_hook(uint8_t port, uint8_t value) {
+    uint8_t rising = value & ~vfd.ports[port];
+    uint8_t prev   = vfd.ports[port];
+    vfd.ports[port] = value;
+
+    // shift DIN on rising edge of CLK
+    if(port == VFD_CLK_PORT && (rising & _BV(VFD_CLK_BIT))) {
+	vfd.shift <<= 1;
+	if(vfd.ports[VFD_DIN_PORT] & _BV(VFD_DIN_BIT)) vfd.shift |= 1;
+	vfd.shift &= 0xFFFFF;
+    }
+
+    // transfer shift register to outputs while LOAD is high
+    if(port == VFD_LOAD_PORT && (rising & _BV(VFD_LOAD_BIT))
+	    && vfd.latch != vfd.shift) {
+	vfd_account();
+	vfd.latch = vfd.shift;
+	vfd_refresh();
+    }
+
+    if(port == VFD_BLANK_PORT
+	    && ((value ^ prev) & _BV(VFD_BLANK_BIT))) {
+	vfd_account();
+	vfd.blank = value & _BV(VFD_BLANK_BIT);
+	vfd_refresh();
+    }
+
+#ifdef VFD_POWER_PORT
+    if(port == VFD_POWER_PORT
+	    && ((value ^ prev) & _BV(VFD_POWER_BIT))) {
+	vfd_account();
+	vfd.off = value & _BV(VFD_POWER_BIT);
+	vfd_refresh();
+    }
+#endif  // VFD_POWER_PORT
+
+    if(vfd.capture && (value ^ prev)) vfd_capture();
+}
+
+
+// prints a seven-segment frame
+static void vfd_print(void) {
+    static const uint8_t rows[3][3] = {
+	{0,         VFD_SEG_A, 0        },
+	{VFD_SEG_F, VFD_SEG_G, VFD_SEG_B},
+	{VFD_SEG_E, VFD_SEG_D, VFD_SEG_C},
+    };
+    static const char glyphs[3][3] = {
+	{' ', '_', ' '},
+	{'|', '_', '|'},
+	{'|', '_', '|'},
+    };
+
+    printf("%10.6f\n", vfd.frame_start / 1e6);
+
+    for(uint8_t row = 0; row < 3; ++row) {
+	putchar(' ');
+	for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	    for(uint8_t col = 0; col < 3; ++col) {
+		putchar(vfd.frame[idx] & rows[row][col]
+			? glyphs[row][col] : ' ');
+	    }
+	    putchar(row == 2 && (vfd.frame[idx] & VFD_SEG_H) ? '.' : ' ');
+	}
+	putchar('\n');
+    }
+
+    ++vfd.frames;
+}
+
+
+// prints per-digit statistics and ends the simulation
+static void vfd_report(void) {
+    double seconds = vfd.now / 1e6;
+
+    printf("\n%lu frames in %.3f seconds\n",
+	    (unsigned long)vfd.frames, seconds);
+    printf("digit  refresh (Hz)  on-time (%%)\n");
+    for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	printf("%5u  %12.1f  %11.2f\n", idx,
+		vfd.refreshes[idx] / seconds,
+		100.0 * vfd.on_time[idx] / vfd.now);
+    }
+    printf("eeprom writes: %lu\n", (unsigned long)hal.eeprom_writes);
+    if(vfd.expects) {
+	printf("%lu expectations, %lu failed\n",
+		(unsigned long)vfd.expects, (unsigned long)vfd.failures);
+    }
+
+    if(vfd.capture) fclose(vfd.capture);
+
+    exit(vfd.failures ? 1 : 0);
+}
+
+
+// returns the segments display_char() lights for a
+// character of expected text; zero for a space
+static uint8_t vfd_char_segments(char c) {
+    if('0' <= c && c <= '9') return pgm_read_byte(&number_segments[c - '0']);
+    if('a' <= c && c <= 'z') return pgm_read_byte(&letter_segments_ada[c - 'a']);
+    if('A' <= c && c <= 'Z') return pgm_read_byte(&letter_segments_alt[c - 'A']);
+    if(c == '-') return VFD_SEG_G;
+
+    return 0;
+}
+
+
+// returns a character that lights the given segments
+// (digits are preferred to letters) or "?" if none does
+static char vfd_segments_char(uint8_t segments) {
+    static const char chars[] = " -0123456789abcdefghijklmnopqrstuvwxyz"
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    for(const char *c = chars; *c; ++c) {
+	if(vfd_char_segments(*c) == segments) return *c;
+    }
+
+    return '?';
+}
+
+
+// checks the last printed frame against expected text
+static void vfd_expect(const char *text) {
+    char shown[DISPLAY_SIZE + 1] = {0};
+    uint8_t failed = 0;
+
+    for(uint8_t idx = 0; idx < DISPLAY_SIZE; ++idx) {
+	uint8_t segments = vfd.shown[idx] & ~VFD_SEG_H;
+
+	shown[idx] = vfd_segments_char(segments);
+	if(text[idx] != '?' && vfd_char_segments(text[idx]) != segments) {
+	    failed = 1;
+	}
+    }
+
+    ++vfd.expects;
+    if(failed) {
+	++vfd.failures;
+	fprintf(stderr, "vfd: %.6f: expected \"%s\", shown \"%s\"\n",
+		vfd.now / 1e6, text, shown);
+    }
+}
+
+
+// performs due script actions
+static void vfd_script(void) {
+    while(vfd.script_idx < vfd.script_len
+	    && vfd.script[vfd.script_idx].time <= vfd.now) {
+	vfd_action_t *action = &vfd.script[vfd.script_idx++];
+
+	switch(action->type) {
+	    case VFD_PIN:
+		switch(action->port) {
+		    case 'B':
+			if(action->value) PINB |=  _BV(action->bit);
+			else              PINB &= ~_BV(action->bit);
+			PCINT0_vect();
+			++vfd.wakes;
+			break;
+		    case 'C':
+			if(action->value) PINC |=  _BV(action->bit);
+			else              PINC &= ~_BV(action->bit);
+			break;
+		    case 'D':
+			if(action->value) PIND |=  _BV(action->bit);
+			else              PIND &= ~_BV(action->bit);
+			PCINT2_vect();
+			++vfd.wakes;
+			break;
+		}
+		break;
+	    case VFD_LIGHT:
+		vfd.light = action->value;
+		break;
+	    case VFD_POWER:
+		// AIN1 follows the adaptor voltage; when it falls, the
+		// comparator interrupt sleeps until power is restored
+		// (time passes in nested calls to the sleep hook)
+		hal.battery = !action->value;
+		if(action->value) {
+		    PIND |= _BV(PD7);
+		    if((PCICR & _BV(PCIE2)) && (PCMSK2 & _BV(PCINT23))) {
+			PCINT2_vect();
+			++vfd.wakes;
+		    }
+		} else {
+		    PIND &= ~_BV(PD7);
+		    if(ACSR & _BV(ACIE)) ANALOG_COMP_vect();
+		}
+		break;
+	    case VFD_GPS:
+#ifdef GPS_TIMEKEEPING
+		// characters are lost while reception is disabled
+		for(const char *c = action->text;
+			*c && (UCSR0B & _BV(RXCIE0)); ++c) {
+		    UDR0 = *c;
+		    USART_RX_vect();
+		}
+#endif  // GPS_TIMEKEEPING
+		break;
+	    case VFD_EXPECT:
+		vfd_expect(action->text);
+		break;
+	}
+    }
+}
+
+
+// advances time by one timer0 overflow, printing the
+// frame if its period ended, and performs due script actions
+static void vfd_advance(void) {
+    vfd.now = ++vfd.overflows * VFD_OVERFLOW_US;
+
+    if(vfd.now - vfd.frame_start >= VFD_FRAME_US) {
+	vfd_account();
+	if(memcmp(vfd.frame, vfd.shown, DISPLAY_SIZE)) {
+	    vfd_print();
+	    memcpy(vfd.shown, vfd.frame, DISPLAY_SIZE);
+	}
+	memset(vfd.frame, 0, DISPLAY_SIZE);
+	vfd.frame_start = vfd.now;
+    }
+
+    if(vfd.now >= vfd.end) vfd_report();
+
+    vfd_script();
+}
+
+
+// calls the timer2 interrupt if due; returns true if called
+static uint8_t vfd_timer2(void) {
+    if(vfd.now < vfd.timer2_due) return 0;
+
+    static const uint16_t prescale[] = {0, 1, 8, 32, 64, 128, 256, 1024};
+
+    TIMER2_COMPB_vect();
+
+    // the next period is OCR2A + 1 counts of the prescaled crystal,
+    // normally one second; several seconds with TICKLESS_SLEEP
+    uint16_t div = prescale[TCCR2B & (_BV(CS22) | _BV(CS21) | _BV(CS20))];
+    vfd.timer2_due += (div ? (uint64_t)(OCR2A + 1) * div * VFD_SECOND_US
+			     / VFD_XTAL_HZ : VFD_SECOND_US);
+    return 1;
+}
+
+
+// calls the watchdog interrupt if enabled and due; returns true if called
+static uint8_t vfd_wdt(void) {
+    if(!(WDTCSR & _BV(WDIE))) {
+	vfd.wdt_due = 0;
+	return 0;
+    }
+
+    if(!vfd.wdt_due) vfd.wdt_due = vfd.now + VFD_WDT_US;
+    if(vfd.now < vfd.wdt_due) return 0;
+
+    vfd.wdt_due = 0;
+    WDT_vect();
+    return 1;
+}
+
+
+// called from sleep_cpu(); advances time until an interrupt
+static void vfd_sleep_hook(void) {
+    hal_port_flush();
+
+    // timer0 and the adc are stopped in power-save mode
+    if((SMCR & (_BV(SM2) | _BV(SM1) | _BV(SM0))) == SLEEP_MODE_PWR_SAVE) {
+	uint32_t wakes = vfd.wakes;
+
+	do {
+	    vfd_advance();
+	} while(!vfd_timer2() && !vfd_wdt() && vfd.wakes == wakes);
+
+	return;
+    }
+
+    vfd_advance();
+
+    // complete any pending analog to digital conversion
+    if(ADCSRA & _BV(ADSC)) {
+	ADCSRA &= ~_BV(ADSC);
+	ADC = vfd.light;
+	ADC_vect();
+    }
+
+    TIMER0_OVF_vect();
+    vfd_timer2();
+    vfd_wdt();
+}
+
+
+// reads a script of timed actions
+static void vfd_load(FILE *file) {
+    char line[128];
+
+    while(fgets(line, sizeof(line), file)) {
+	vfd_action_t action = {0};
+	char port;
+	unsigned bit, value;
+	double seconds;
+	int len;
+
+	if(line[0] == '#' || line[0] == '\n') continue;
+
+	if(vfd.script_len >= VFD_SCRIPT_SIZE) {
+	    fprintf(stderr, "vfd: script too long\n");
+	    exit(1);
+	}
+
+	if(sscanf(line, "%lf pin %c%u %u", &seconds, &port, &bit, &value) == 4
+		&& (port == 'B' || port == 'C' || port == 'D') && bit < 8) {
+	    action.type  = VFD_PIN;
+	    action.port  = port;
+	    action.bit   = bit;
+	    action.value = value;
+	} else if(sscanf(line, "%lf light %u", &seconds, &value) == 2) {
+	    action.type  = VFD_LIGHT;
+	    action.value = value;
+	} else if(sscanf(line, "%lf power %u", &seconds, &value) == 2
+		&& value <= 1) {
+	    action.type  = VFD_POWER;
+	    action.value = value;
+#ifdef GPS_TIMEKEEPING
+	} else if(sscanf(line, "%lf gps %80s", &seconds, action.text) == 2) {
+	    action.type = VFD_GPS;
+	    strcat(action.text, "\r\n");
+#endif  // GPS_TIMEKEEPING
+	} else if(sscanf(line, "%lf expect \"%83[^\"]\"%n",
+			  &seconds, action.text, &len) == 2
+		&& len > 0 && strlen(action.text) == DISPLAY_SIZE) {
+	    action.type = VFD_EXPECT;
+	} else {
+	    fprintf(stderr, "vfd: bad script line: %s", line);
+	    exit(1);
+	}
+
+	action.time = seconds * 1e6;
+	vfd.script[vfd.script_len++] = action;
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    while((opt = getopt(argc, argv, "c:")) != -1) {
+	switch(opt) {
+	    case 'c':
+		vfd.capture = fopen(optarg, "w");
+		if(!vfd.capture) {
+		    perror(optarg);
+		    return 1;
+		}
+		fprintf(vfd.capture, "# %s\n", VFD_MULTIPLEXING);
+		break;
+	    default:
+		argc = 0;  // print usage
+		break;
+	}
+    }
+
+    if(argc - optind < 1 || argc - optind > 2) {
+	fprintf(stderr, "usage: vfd [-c capture] seconds [script]\n");
+	return 1;
+    }
+
+    vfd.end = strtod(argv[optind], NULL) * 1e6;
+    vfd.timer2_due = VFD_SECOND_US;
+
+    if(argc - optind == 2) {
+	FILE *file = fopen(argv[optind + 1], "r");
+	if(!file) {
+	    perror(argv[optind + 1]);
+	    return 1;
+	}
+	vfd_load(file);
+	fclose(file);
+    }
+
+    // inputs are pulled up, so buttons are released
+    PINB = PINC = PIND = 0xFF;
+    UCSR0A = _BV(UDRE0);  // usart is always ready to transmit
+
+    hal.port_hook  = vfd_port_hook;
+    hal.sleep_hook = vfd_sleep_hook;
+
+    firmware_main();  // returns only by vfd_report()
+
+    return 0;
+}
@@ -127,11 +127,23 @@ ISR(TIMER2_COMPB_vect) {
 	if(system.status & SYSTEM_SLEEP) {
 	    wdt_reset();
 
-	    system_tick();
-	    time_tick();
-	    alarm_tick();
-	    piezo_tick();
-	    temp_tick();
+	    // catch up on seconds since previous interrupt, which is
+	    // always one second unless TICKLESS_SLEEP is defined
+	    for(uint8_t n = time_tickless_elapsed(); n; --n) {
+		system_tick();
+		time_tick();
+		alarm_tick();
+		piezo_tick();
+		temp_tick();
+	    }
+
+#ifdef TICKLESS_SLEEP
+	    // interrupt again when next event is due
+	    uint8_t due = system_sleep_due();
+	    uint8_t alarm = alarm_due();
+	    if(alarm < due) due = alarm;
+	    time_tickless_period(due);
+#endif  // TICKLESS_SLEEP
 	} else {
 	    if(semitick_successful) wdt_reset();
 	    semitick_successful = 0;
@@ -159,6 +171,9 @@ ISR(TIMER0_OVF_vect) {
 	// display code needs additional control over multiplexing
 	display_semisemitick();
 
+	// 1-wire communication is timed by timer0 overflows
+	temp_semisemitick();
+
 	// interupt just returns 31 out of 32 times
 	static uint8_t semicounter = 1;
 	if(semicounter && !--semicounter) {
@@ -184,6 +199,28 @@ ISR(TIMER0_OVF_vect) {
 }
 
 
+// pin change interrupts
+// triggered by button and alarm switch edges while awake;
+// during sleep, PCINT23 (AIN1) only wakes the system
+ISR(PCINT0_vect) {
+    buttons_pcint();
+}
+
+ISR(PCINT2_vect) {
+    // button pins are clamped low during sleep and would read as pressed
+    if(!(system.status & SYSTEM_SLEEP)) buttons_pcint();
+    alarm_pcint();
+}
+
+
+// analog to digital conversion complete interrupt
+// chains photoresistor conversions while awake; during sleep,
+// only wakes the system from adc noise reduction mode
+ISR(ADC_vect) {
+    display_adc();
+}
+
+
 // analog comparator interrupt
 // triggered when voltage at AIN1 falls below internal
 // bandgap (~1.1v), indicating external power failure
@@ -196,21 +233,32 @@ ISR(ANALOG_COMP_vect) {
     // if power is good, do nothing
     if(system_power() == SYSTEM_ADAPTOR) return;
 
+    // the supply capacitor is draining, so cut the largest loads
+    // first and leave the slow eeprom writes for last
     display_sleep();  // stop boost timer and disable display
+    temp_sleep();     // disable temperature sensor
+    gps_sleep();      // disable usart rx interrupt
+    usart_sleep();    // disable usart
     alarm_sleep();    // disable alarm-switch pull-up resistor
     buttons_sleep();  // disable button pull-up resistors
-    time_sleep();     // save current time
     mode_sleep();     // does nothing
-    gps_sleep();      // disable usart rx interrupt
-    usart_sleep();    // disable usart
-    piezo_sleep();    // adjust buzzer timer for slower clock
-    temp_sleep();     // disable temperature sensor
     system_sleep();   // reset sleep/wake timer
+    piezo_sleep();    // adjust buzzer timer for slower clock
 
     // the bod settings allow the clock to run a battery down to 1.7 - 2.0v.
-    // An 8 or 4 MHz clock is unstable at 1.7v, but a 2 MHz clock is okay:
+    // An 8 or 4 MHz clock is unstable at 1.7v, but a 2 MHz clock is okay.
+    // eeprom programming is timed by its own oscillator, so the slower
+    // clock does not lengthen the save below; it only makes the busy wait
+    // for each byte draw less current
     clock_prescale_set(clock_div_4);
 
+    // the save cannot be deferred into the sleep loop:  with a dead
+    // battery, the supply capacitor must still hold it up, and each byte
+    // must be started by the cpu.  it waits for six 1.8 ms writes, about
+    // 10.8 ms or 21600 cycles at 2 MHz; the read-back adds about a
+    // hundred cycles, and the final valid byte completes during sleep
+    time_sleep();     // save current time
+
     system_sleep_loop();  // sleep until power restored
 
     time_wake();  // save current time
@@ -1,7 +1,11 @@
 // mode.c  --  time display and user interaction
 //
 // Time display and menu configuration are implemented through various
-// modes or states within a finite state machine.
+// modes or states within a finite state machine.  Menus that only
+// lead to other states are described by the mode_menus[] table, and
+// values stepped through a range by the mode_edits[] table; both are
+// indexed by state.  Other states, and the display of values, are
+// handled by the switch statements in mode_semitick() and mode_update().
 //
 
 
@@ -18,6 +22,7 @@
 #include "buttons.h"  // for processing button presses
 #include "gps.h"      // for setting the utc offset
 #include "usart.h"    // for debugging output
+#include "temp.h"     // for temperature sensor errors
 
 #define BLINK_OFF_SEMITICKS 128
 
@@ -35,11 +40,429 @@ void mode_settime_display(uint8_t hour, uint8_t minute, uint8_t second);
 void mode_alarm_display(uint8_t hour, uint8_t minute);
 void mode_textnum_display(PGM_P pstr, int8_t num);
 void mode_texttext_display(PGM_P txt, PGM_P opt);
+#ifdef BATTERY_GAUGE
+void mode_threedigit_display(PGM_P label, uint16_t num);
+#endif  // BATTERY_GAUGE
 void mode_monthday_display(void);
 void mode_daysofweek_display(uint8_t days);
-void mode_menu_process_button(uint8_t up, uint8_t next, uint8_t down,
-			      void (*init_func)(void), uint8_t btn,
-			      uint8_t next_is_up);
+const mode_menu_t *mode_menu_find(uint8_t state);
+void mode_menu_process(uint8_t state, uint8_t btn);
+void mode_menu_display(uint8_t state);
+const mode_edit_t *mode_edit_find(uint8_t state);
+void mode_edit_process(uint8_t state, uint8_t btn);
+
+
+// functions to prepare mode.tmp when entering menus
+static void mode_menu_setalarm_init(void) {
+    *mode.tmp = 0;
+}
+
+static void mode_menu_settime_init(void) {
+    mode.tmp[MODE_TMP_HOUR]   = time.hour;
+    mode.tmp[MODE_TMP_MINUTE] = time.minute;
+    mode.tmp[MODE_TMP_SECOND] = time.second;
+}
+
+static void mode_menu_setdate_init(void) {
+    mode.tmp[MODE_TMP_YEAR]  = time.year;
+    mode.tmp[MODE_TMP_MONTH] = time.month;
+    mode.tmp[MODE_TMP_DAY]   = time.day;
+}
+
+static void mode_menu_cfgalarm_setsound_init(void) {
+    piezo_setvolume((alarm.volume_min + alarm.volume_max) >> 1, 0);
+    piezo_tryalarm_start();
+}
+
+static void mode_menu_cfgalarm_setvol_init(void) {
+    if(alarm.volume_min != alarm.volume_max) {
+	*mode.tmp = 11;
+    } else {
+	*mode.tmp = alarm.volume_min;
+	piezo_setvolume(alarm.volume_min, 0);
+	piezo_tryalarm_start();
+    }
+    mode.tmp[MODE_TMP_MIN] = alarm.volume_min;
+    mode.tmp[MODE_TMP_MAX] = alarm.volume_max;
+}
+
+static void mode_menu_cfgalarm_setsnooze_init(void) {
+    *mode.tmp = alarm.snooze_time / 60;
+}
+
+static void mode_menu_cfgalarm_setheartbeat_init(void) {
+    *mode.tmp = alarm.status & (ALARM_SOUNDING_PULSE | ALARM_SNOOZING_PULSE);
+
+    if(*mode.tmp) {
+	display.status |=  DISPLAY_PULSING;
+    } else {
+	display.status &= ~DISPLAY_PULSING;
+	display_autodim();
+    }
+}
+
+static void mode_menu_cfgdisp_setbright_init(void) {
+#ifdef AUTOMATIC_DIMMER
+    mode.tmp[MODE_TMP_MIN] = display.bright_min;
+    mode.tmp[MODE_TMP_MAX] = display.bright_max;
+
+    if(display.bright_min == display.bright_max) {
+	*mode.tmp = display.bright_min;
+    } else {
+	*mode.tmp = 11;
+    }
+#endif  // AUTOMATIC_DIMMER
+}
+
+#ifndef SEGMENT_MULTIPLEXING
+static void mode_menu_cfgdisp_setdigitbright_init(void) {
+    *mode.tmp = 0;
+}
+#endif  // ~SEGMENT_MULTIPLEXING
+
+#ifdef AUTOMATIC_DIMMER
+static void mode_menu_cfgdisp_setphotooff_init(void) {
+    uint8_t off_thr = display.off_threshold;
+    for(*mode.tmp = 0; off_thr; off_thr >>= 1) ++(*mode.tmp);
+}
+#endif  // AUTOMATIC_DIMMER
+
+static void mode_menu_cfgdisp_setofftime_init(void) {
+    *mode.tmp = display.off_hour & _BV(TIME_NODAY);
+}
+
+static void mode_menu_cfgdisp_setoffdays_init(void) {
+    *mode.tmp = display.off_days;
+}
+
+static void mode_menu_cfgdisp_setondays_init(void) {
+    *mode.tmp = display.on_days;
+}
+
+static void mode_menu_cfgdisp_setanimated_init(void) {
+    *mode.tmp = display.status;
+}
+
+static void mode_menu_cfgregn_setdst_init(void) {
+    *mode.tmp = time.status;
+}
+
+#ifdef GPS_TIMEKEEPING
+static void mode_menu_cfgregn_setzone_init(void) {
+    mode.tmp[MODE_TMP_HOUR]   = gps.rel_utc_hour;
+    mode.tmp[MODE_TMP_MINUTE] = gps.rel_utc_minute;
+}
+#endif  // GPS_TIMEKEEPING
+
+static void mode_menu_cfgregn_timefmt_init(void) {
+    *mode.tmp = time.timeformat_flags;
+}
+
+static void mode_menu_cfgregn_datefmt_init(void) {
+    *mode.tmp = time.dateformat;
+}
+
+
+// menu tree, indexed by state: for each menu, the menu label, the states
+// for the menu, set, and plus buttons, and the function to call before
+// entering
+const mode_menu_t mode_menus[MODE_MENU_COUNT] PROGMEM = {
+    [MODE_SETALARM_MENU - MODE_MENU_FIRST] = {
+      "set alar", 0,
+      MODE_TIME_DISPLAY, MODE_SETTIME_MENU, MODE_SETALARM_IDX,
+      mode_menu_setalarm_init },
+    [MODE_SETTIME_MENU - MODE_MENU_FIRST] = {
+      "set time", 0,
+      MODE_TIME_DISPLAY, MODE_SETDATE_MENU, MODE_SETTIME_HOUR,
+      mode_menu_settime_init },
+    [MODE_SETDATE_MENU - MODE_MENU_FIRST] = {
+      "set date", 0,
+      MODE_TIME_DISPLAY, MODE_CFGALARM_MENU, MODE_SETDATE_YEAR,
+      mode_menu_setdate_init },
+    [MODE_CFGALARM_MENU - MODE_MENU_FIRST] = {
+      "cfg alar", 0,
+      MODE_TIME_DISPLAY, MODE_CFGDISP_MENU, MODE_CFGALARM_SETSOUND_MENU,
+      NULL },
+    [MODE_CFGALARM_SETSOUND_MENU - MODE_MENU_FIRST] = {
+      "a sound", MODE_MENU_DOT,
+      MODE_TIME_DISPLAY, MODE_CFGALARM_SETVOL_MENU, MODE_CFGALARM_SETSOUND,
+      mode_menu_cfgalarm_setsound_init },
+    [MODE_CFGALARM_SETVOL_MENU - MODE_MENU_FIRST] = {
+      "a volume", MODE_MENU_DOT,
+      MODE_TIME_DISPLAY, MODE_CFGALARM_SETSNOOZE_MENU, MODE_CFGALARM_SETVOL,
+      mode_menu_cfgalarm_setvol_init },
+    [MODE_CFGALARM_SETSNOOZE_MENU - MODE_MENU_FIRST] = {
+      "a snooze", MODE_MENU_DOT,
+      MODE_TIME_DISPLAY, MODE_CFGALARM_SETHEARTBEAT_MENU,
+      MODE_CFGALARM_SETSNOOZE_TIME,
+      mode_menu_cfgalarm_setsnooze_init },
+    [MODE_CFGALARM_SETHEARTBEAT_MENU - MODE_MENU_FIRST] = {
+      "a pulse ",
+      MODE_MENU_DOT | MODE_MENU_LAST,
+      MODE_TIME_DISPLAY,
+#ifdef ADAFRUIT_BUTTONS
+      MODE_CFGALARM_MENU,
+#else
+      MODE_CFGALARM_SETSOUND_MENU,
+#endif  // ADAFRUIT_BUTTONS
+      MODE_CFGALARM_SETHEARTBEAT_TOGGLE,
+      mode_menu_cfgalarm_setheartbeat_init },
+    [MODE_CFGDISP_MENU - MODE_MENU_FIRST] = {
+      "cfg disp", 0,
+      MODE_TIME_DISPLAY, MODE_CFGREGN_MENU, MODE_CFGDISP_SETBRIGHT_MENU,
+      NULL },
+    [MODE_CFGDISP_SETBRIGHT_MENU - MODE_MENU_FIRST] = {
+      "disp bri", 0,
+      MODE_TIME_DISPLAY,
+#ifndef SEGMENT_MULTIPLEXING
+      MODE_CFGDISP_SETDIGITBRIGHT_MENU,
+#else
+      MODE_CFGDISP_SETAUTOOFF_MENU,
+#endif  // ~SEGMENT_MULTIPLEXING
+      MODE_CFGDISP_SETBRIGHT_LEVEL,
+      mode_menu_cfgdisp_setbright_init },
+#ifndef SEGMENT_MULTIPLEXING
+    [MODE_CFGDISP_SETDIGITBRIGHT_MENU - MODE_MENU_FIRST] = {
+      "digt bri", 0,
+      MODE_TIME_DISPLAY, MODE_CFGDISP_SETAUTOOFF_MENU,
+      MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
+      mode_menu_cfgdisp_setdigitbright_init },
+#endif  // ~SEGMENT_MULTIPLEXING
+    [MODE_CFGDISP_SETAUTOOFF_MENU - MODE_MENU_FIRST] = {
+      "auto off", 0,
+      MODE_TIME_DISPLAY, MODE_CFGDISP_SETANIMATED_MENU,
+#ifdef AUTOMATIC_DIMMER
+      MODE_CFGDISP_SETPHOTOOFF_MENU,
+#else
+      MODE_CFGDISP_SETOFFTIME_MENU,
+#endif  // AUTOMATIC_DIMMER
+      NULL },
+#ifdef AUTOMATIC_DIMMER
+    [MODE_CFGDISP_SETPHOTOOFF_MENU - MODE_MENU_FIRST] = {
+      "off dark", 0,
+      MODE_TIME_DISPLAY, MODE_CFGDISP_SETOFFTIME_MENU,
+      MODE_CFGDISP_SETPHOTOOFF_THRESH,
+      mode_menu_cfgdisp_setphotooff_init },
+#endif  // AUTOMATIC_DIMMER
+    [MODE_CFGDISP_SETOFFTIME_MENU - MODE_MENU_FIRST] = {
+      "off time", 0,
+      MODE_TIME_DISPLAY, MODE_CFGDISP_SETOFFDAYS_MENU,
+      MODE_CFGDISP_SETOFFTIME_TOGGLE,
+      mode_menu_cfgdisp_setofftime_init },
+    [MODE_CFGDISP_SETOFFDAYS_MENU - MODE_MENU_FIRST] = {
+      "off days", 0,
+      MODE_TIME_DISPLAY, MODE_CFGDISP_SETONDAYS_MENU,
+      MODE_CFGDISP_SETOFFDAYS_OPTIONS,
+      mode_menu_cfgdisp_setoffdays_init },
+    [MODE_CFGDISP_SETONDAYS_MENU - MODE_MENU_FIRST] = {
+      "on days ", 0,
+      MODE_TIME_DISPLAY,
+#ifdef AUTOMATIC_DIMMER
+      MODE_CFGDISP_SETPHOTOOFF_MENU,
+#else
+      MODE_CFGDISP_SETOFFTIME_MENU,
+#endif  // AUTOMATIC_DIMMER
+      MODE_CFGDISP_SETONDAYS_OPTIONS,
+      mode_menu_cfgdisp_setondays_init },
+    [MODE_CFGDISP_SETANIMATED_MENU - MODE_MENU_FIRST] = {
+      "animated", MODE_MENU_LAST,
+      MODE_TIME_DISPLAY,
+#ifdef ADAFRUIT_BUTTONS
+      MODE_CFGDISP_MENU,
+#else
+      MODE_CFGDISP_SETBRIGHT_MENU,
+#endif  // ADAFRUIT_BUTTONS
+      MODE_CFGDISP_SETANIMATED_TOGGLE,
+      mode_menu_cfgdisp_setanimated_init },
+#ifdef BATTERY_GAUGE
+    [MODE_CFGREGN_MENU - MODE_MENU_FIRST] = {
+      "cfg regn", 0,
+      MODE_TIME_DISPLAY, MODE_BATTERY_MENU, MODE_CFGREGN_SETDST_MENU,
+      NULL },
+#else
+    [MODE_CFGREGN_MENU - MODE_MENU_FIRST] = {
+      "cfg regn", MODE_MENU_LAST,
+      MODE_TIME_DISPLAY,
+#ifdef ADAFRUIT_BUTTONS
+      MODE_TIME_DISPLAY,
+#else
+      MODE_SETALARM_MENU,
+#endif  // ADAFRUIT_BUTTONS
+      MODE_CFGREGN_SETDST_MENU,
+      NULL },
+#endif  // BATTERY_GAUGE
+    [MODE_CFGREGN_SETDST_MENU - MODE_MENU_FIRST] = {
+      "set dst", 0,
+      MODE_TIME_DISPLAY,
+#ifdef GPS_TIMEKEEPING
+      MODE_CFGREGN_SETZONE_MENU,
+#else
+      MODE_CFGREGN_TIMEFMT_MENU,
+#endif  // GPS_TIMEKEEPING
+      MODE_CFGREGN_SETDST_STATE,
+      mode_menu_cfgregn_setdst_init },
+#ifdef GPS_TIMEKEEPING
+    [MODE_CFGREGN_SETZONE_MENU - MODE_MENU_FIRST] = {
+      "set zone", 0,
+      MODE_TIME_DISPLAY, MODE_CFGREGN_TIMEFMT_MENU, MODE_CFGREGN_SETZONE_HOUR,
+      mode_menu_cfgregn_setzone_init },
+#endif  // GPS_TIMEKEEPING
+    [MODE_CFGREGN_TIMEFMT_MENU - MODE_MENU_FIRST] = {
+      "time fmt", 0,
+      MODE_TIME_DISPLAY, MODE_CFGREGN_DATEFMT_MENU,
+      MODE_CFGREGN_TIMEFMT_12HOUR,
+      mode_menu_cfgregn_timefmt_init },
+    [MODE_CFGREGN_DATEFMT_MENU - MODE_MENU_FIRST] = {
+      "date fmt", 0,
+      MODE_TIME_DISPLAY, MODE_CFGREGN_MISCFMT_MENU,
+      MODE_CFGREGN_DATEFMT_SHOWWDAY,
+      mode_menu_cfgregn_datefmt_init },
+    [MODE_CFGREGN_MISCFMT_MENU - MODE_MENU_FIRST] = {
+      "misc fmt", MODE_MENU_LAST,
+      MODE_TIME_DISPLAY,
+#ifdef ADAFRUIT_BUTTONS
+      MODE_CFGREGN_MENU,
+#else
+      MODE_CFGREGN_SETDST_MENU,
+#endif  // ADAFRUIT_BUTTONS
+      MODE_CFGREGN_MISCFMT_ZEROPAD,
+      NULL },
+#ifdef BATTERY_GAUGE
+    [MODE_BATTERY_MENU - MODE_MENU_FIRST] = {
+      "battery", MODE_MENU_LAST,
+      MODE_TIME_DISPLAY,
+#ifdef ADAFRUIT_BUTTONS
+      MODE_TIME_DISPLAY,
+#else
+      MODE_SETALARM_MENU,
+#endif  // ADAFRUIT_BUTTONS
+      MODE_BATTERY_VOLTAGE,
+      system_gauge_dump },
+#endif  // BATTERY_GAUGE
+};
+
+
+// functions to save values when leaving value settings
+static void mode_edit_settime_save(void) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	time_settime(mode.tmp[MODE_TMP_HOUR],
+		     mode.tmp[MODE_TMP_MINUTE],
+		     mode.tmp[MODE_TMP_SECOND]);
+	time_autodst(FALSE);
+    }
+    time_savetime();
+}
+
+static void mode_edit_setdate_save(void) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	time_setdate(mode.tmp[MODE_TMP_YEAR],
+		     mode.tmp[MODE_TMP_MONTH],
+		     mode.tmp[MODE_TMP_DAY]);
+	time_autodst(FALSE);
+    }
+    time_savedate();
+}
+
+static void mode_edit_cfgalarm_setvol_time_save(void) {
+    alarm.ramp_time = *mode.tmp;
+    alarm_newramp();  // calculate alarm.ramp_int
+    alarm_saveramp(); // save alarm.ramp_time
+}
+
+static void mode_edit_cfgalarm_setsnooze_save(void) {
+    alarm.snooze_time = *mode.tmp * 60;
+    alarm_savesnooze();
+}
+
+#ifdef AUTOMATIC_DIMMER
+static void mode_edit_cfgdisp_setphotooff_save(void) {
+    display.off_threshold = (*mode.tmp ? (1<<(*mode.tmp-1)) : 0);
+    display_savephotooff();
+}
+#endif  // AUTOMATIC_DIMMER
+
+#ifdef GPS_TIMEKEEPING
+static void mode_edit_cfgregn_setzone_save(void) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	gps.rel_utc_hour   = mode.tmp[MODE_TMP_HOUR  ];
+	gps.rel_utc_minute = mode.tmp[MODE_TMP_MINUTE];
+	gps_saverelutc();
+    }
+}
+#endif  // GPS_TIMEKEEPING
+
+
+// value settings, indexed by state: for each value, its location and
+// range, the state after the set button and its transition, and the
+// functions to save the value or to restore it after cancel or timeout
+#define MODE_EDIT_OFFTIME(field) ((volatile int8_t *)&display.field)
+
+const mode_edit_t mode_edits[MODE_EDIT_COUNT] PROGMEM = {
+    [MODE_SETTIME_HOUR - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_HOUR], 0, 23, 0,
+      MODE_SETTIME_MINUTE, DISPLAY_TRANS_INSTANT,
+      NULL, NULL },
+    [MODE_SETTIME_MINUTE - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_MINUTE], 0, 59, 0,
+      MODE_SETTIME_SECOND, DISPLAY_TRANS_INSTANT,
+      NULL, NULL },
+    [MODE_SETTIME_SECOND - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_SECOND], 0, 59, 0,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      mode_edit_settime_save, NULL },
+    [MODE_SETDATE_YEAR - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_YEAR], 10, 50, 0,
+      MODE_SETDATE_MONTH, DISPLAY_TRANS_INSTANT,
+      NULL, NULL },
+    [MODE_SETDATE_MONTH - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_MONTH], 1, 12, 0,
+      MODE_SETDATE_DAY, DISPLAY_TRANS_LEFT,
+      NULL, NULL },
+    [MODE_SETDATE_DAY - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_DAY], 1, 31, MODE_EDIT_MONTHDAYS,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      mode_edit_setdate_save, NULL },
+    [MODE_CFGALARM_SETVOL_TIME - MODE_EDIT_FIRST] = {
+      mode.tmp, 1, 60, 0,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      mode_edit_cfgalarm_setvol_time_save, NULL },
+    [MODE_CFGALARM_SETSNOOZE_TIME - MODE_EDIT_FIRST] = {
+      mode.tmp, 0, 30, 0,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      mode_edit_cfgalarm_setsnooze_save, NULL },
+#ifdef AUTOMATIC_DIMMER
+    [MODE_CFGDISP_SETPHOTOOFF_THRESH - MODE_EDIT_FIRST] = {
+      mode.tmp, 0, 8, 0,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      mode_edit_cfgdisp_setphotooff_save, NULL },
+#endif  // AUTOMATIC_DIMMER
+    [MODE_CFGDISP_SETOFFTIME_OFFHOUR - MODE_EDIT_FIRST] = {
+      MODE_EDIT_OFFTIME(off_hour), 0, 23, 0,
+      MODE_CFGDISP_SETOFFTIME_OFFMINUTE, DISPLAY_TRANS_INSTANT,
+      NULL, display_loadofftime },
+    [MODE_CFGDISP_SETOFFTIME_OFFMINUTE - MODE_EDIT_FIRST] = {
+      MODE_EDIT_OFFTIME(off_minute), 0, 59, 0,
+      MODE_CFGDISP_SETOFFTIME_ONHOUR, DISPLAY_TRANS_UP,
+      NULL, display_loadofftime },
+    [MODE_CFGDISP_SETOFFTIME_ONHOUR - MODE_EDIT_FIRST] = {
+      MODE_EDIT_OFFTIME(on_hour), 0, 23, 0,
+      MODE_CFGDISP_SETOFFTIME_ONMINUTE, DISPLAY_TRANS_INSTANT,
+      NULL, display_loadofftime },
+    [MODE_CFGDISP_SETOFFTIME_ONMINUTE - MODE_EDIT_FIRST] = {
+      MODE_EDIT_OFFTIME(on_minute), 0, 59, 0,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      display_saveofftime, display_loadofftime },
+#ifdef GPS_TIMEKEEPING
+    [MODE_CFGREGN_SETZONE_HOUR - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_HOUR], GPS_HOUR_OFFSET_MIN, GPS_HOUR_OFFSET_MAX, 0,
+      MODE_CFGREGN_SETZONE_MINUTE, DISPLAY_TRANS_INSTANT,
+      NULL, NULL },
+    [MODE_CFGREGN_SETZONE_MINUTE - MODE_EDIT_FIRST] = {
+      &mode.tmp[MODE_TMP_MINUTE], 0, 59, 0,
+      MODE_TIME_DISPLAY, DISPLAY_TRANS_UP,
+      mode_edit_cfgregn_setzone_save, NULL },
+#endif  // GPS_TIMEKEEPING
+};
 
 
 // set default startup mode after system reset
@@ -118,8 +541,12 @@ void mode_tick(void) {
 
 // called each semisecond; updates current mode as required
 void mode_semitick(void) {
-    // ignore buttons unless transition is finished
-    if(display.trans_type != DISPLAY_TRANS_NONE) return;
+    // ignore buttons unless transition is finished; only the latest
+    // press is kept, so presses and repeats do not replay afterward
+    if(display.trans_type != DISPLAY_TRANS_NONE) {
+	buttons_coalesce();
+	return;
+    }
 
     uint8_t btn = buttons_process();
 
@@ -253,20 +680,6 @@ void mode_semitick(void) {
 		mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
 	    }
 	    return;  // time ourselves; skip code below
-	case MODE_SETALARM_MENU: ;
-	    void menu_setalarm_init(void) { *mode.tmp = 0; }
-
-	    mode_menu_process_button(
-		MODE_TIME_DISPLAY, 
-#ifdef GPS_TIMEKEEPING
-		(gps.status & GPS_SIGNAL_GOOD ? MODE_CFGALARM_MENU
-		 			      : MODE_SETTIME_MENU),
-#else
-		MODE_SETTIME_MENU,
-#endif  // GPS_TIMEKEEPING
-		MODE_SETALARM_IDX,
-	        menu_setalarm_init, btn, FALSE);
-	    break;
 	case MODE_SETALARM_IDX:
 	    switch(btn) {
 #ifdef ADAFRUIT_BUTTONS
@@ -459,177 +872,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_SETTIME_MENU: ;
-	    void menu_settime_init(void) {
-		mode.tmp[MODE_TMP_HOUR]   = time.hour;
-		mode.tmp[MODE_TMP_MINUTE] = time.minute;
-		mode.tmp[MODE_TMP_SECOND] = time.second;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_SETDATE_MENU,
-		    MODE_SETTIME_HOUR,
-		    menu_settime_init,
-		    btn, FALSE);
-	    break;
-	case MODE_SETTIME_HOUR:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    mode_update(MODE_SETTIME_MINUTE, DISPLAY_TRANS_INSTANT);
-		    break;
-		case BUTTONS_PLUS:
-		    ++mode.tmp[MODE_TMP_HOUR];
-		    mode.tmp[MODE_TMP_HOUR] %= 24;
-		    mode_update(MODE_SETTIME_HOUR, DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_SETTIME_MINUTE:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    mode_update(MODE_SETTIME_SECOND, DISPLAY_TRANS_INSTANT);
-		    break;
-		case BUTTONS_PLUS:
-		    ++mode.tmp[MODE_TMP_MINUTE];
-		    mode.tmp[MODE_TMP_MINUTE] %= 60;
-		    mode_update(MODE_SETTIME_MINUTE, DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_SETTIME_SECOND:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-			time_settime(mode.tmp[MODE_TMP_HOUR],
-				     mode.tmp[MODE_TMP_MINUTE],
-				     mode.tmp[MODE_TMP_SECOND]);
-			time_autodst(FALSE);
-		    }
-		    time_savetime();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    ++mode.tmp[MODE_TMP_SECOND];
-		    mode.tmp[MODE_TMP_SECOND] %= 60;
-		    mode_update(MODE_SETTIME_SECOND, DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_SETDATE_MENU: ;
-	    void menu_setdate_init(void) {
-		mode.tmp[MODE_TMP_YEAR]  = time.year;
-		mode.tmp[MODE_TMP_MONTH] = time.month;
-		mode.tmp[MODE_TMP_DAY]   = time.day;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGALARM_MENU,
-		    MODE_SETDATE_YEAR,
-		    menu_setdate_init,
-		    btn, FALSE);
-	    break;
-	case MODE_SETDATE_YEAR:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    mode_update(MODE_SETDATE_MONTH, DISPLAY_TRANS_INSTANT);
-		    break;
-		case BUTTONS_PLUS:
-		    if(++mode.tmp[MODE_TMP_YEAR] > 50) {
-		        mode.tmp[MODE_TMP_YEAR] = 10;
-		    }
-		    mode_update(MODE_SETDATE_YEAR, DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_SETDATE_MONTH:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    mode_update(MODE_SETDATE_DAY, DISPLAY_TRANS_LEFT);
-		    break;
-		case BUTTONS_PLUS:
-		    ++mode.tmp[MODE_TMP_MONTH];
-		    if(mode.tmp[MODE_TMP_MONTH] > 12) {
-			mode.tmp[MODE_TMP_MONTH] = 1;
-		    }
-		    mode_update(MODE_SETDATE_MONTH, DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_SETDATE_DAY:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-			time_setdate(mode.tmp[MODE_TMP_YEAR],
-				     mode.tmp[MODE_TMP_MONTH],
-				     mode.tmp[MODE_TMP_DAY]);
-			time_autodst(FALSE);
-		    }
-		    time_savedate();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    if(++mode.tmp[MODE_TMP_DAY]
-			    > time_daysinmonth(mode.tmp[MODE_TMP_YEAR],
-					       mode.tmp[MODE_TMP_MONTH])) {
-			mode.tmp[MODE_TMP_DAY] = 1;
-		    }
-		    mode_update(MODE_SETDATE_DAY, DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_CFGALARM_MENU:
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGDISP_MENU,
-		    MODE_CFGALARM_SETSOUND_MENU,
-		    NULL,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGALARM_SETSOUND_MENU: ;
-	    void menu_cfgalarm_setsound_init(void) {
-		piezo_setvolume((alarm.volume_min + alarm.volume_max) >> 1, 0);
-		piezo_tryalarm_start();
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGALARM_SETVOL_MENU,
-		    MODE_CFGALARM_SETSOUND,
-		    menu_cfgalarm_setsound_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGALARM_SETSOUND:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -655,26 +897,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGALARM_SETVOL_MENU: ;
-	    void menu_cfgalarm_setvol_init(void) {
-		if(alarm.volume_min != alarm.volume_max) {
-		    *mode.tmp = 11;
-		} else {
-		    *mode.tmp = alarm.volume_min;
-		    piezo_setvolume(alarm.volume_min, 0);
-		    piezo_tryalarm_start();
-		}
-		mode.tmp[MODE_TMP_MIN] = alarm.volume_min;
-		mode.tmp[MODE_TMP_MAX] = alarm.volume_max;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGALARM_SETSNOOZE_MENU,
-		    MODE_CFGALARM_SETVOL,
-		    menu_cfgalarm_setvol_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGALARM_SETVOL:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -766,81 +988,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGALARM_SETVOL_TIME:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    alarm.ramp_time = *mode.tmp;
-		    alarm_newramp();  // calculate alarm.ramp_int
-		    alarm_saveramp(); // save alarm.ramp_time
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    if(++(*mode.tmp) > 60) *mode.tmp = 1;
-		    mode_update(MODE_CFGALARM_SETVOL_TIME,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_CFGALARM_SETSNOOZE_MENU: ;
-	    void menu_cfgalarm_setsnooze_init(void) {
-		*mode.tmp = alarm.snooze_time / 60;
-	    };
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGALARM_SETHEARTBEAT_MENU,
-		    MODE_CFGALARM_SETSNOOZE_TIME,
-		    menu_cfgalarm_setsnooze_init,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGALARM_SETSNOOZE_TIME:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    alarm.snooze_time = *mode.tmp * 60;
-		    alarm_savesnooze();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    ++(*mode.tmp); *mode.tmp %= 31;
-		    mode_update(MODE_CFGALARM_SETSNOOZE_TIME,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_CFGALARM_SETHEARTBEAT_MENU: ;
-	    void menu_cfgalarm_setheartbeat_init(void) {
-		*mode.tmp = alarm.status
-		            & (ALARM_SOUNDING_PULSE | ALARM_SNOOZING_PULSE);
-
-		if(*mode.tmp) {
-		    display.status |=  DISPLAY_PULSING;
-		} else {
-		    display.status &= ~DISPLAY_PULSING;
-		    display_autodim();
-		}
-	    };
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifdef ADAFRUIT_BUTTONS
-		    MODE_CFGALARM_MENU,
-#else
-		    MODE_CFGALARM_SETSOUND_MENU,
-#endif  // ADAFRUIT_BUTTONS
-		    MODE_CFGALARM_SETHEARTBEAT_TOGGLE,
-		    menu_cfgalarm_setheartbeat_init,
-		    btn, TRUE);
-	    break;
 	case MODE_CFGALARM_SETHEARTBEAT_TOGGLE:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -890,39 +1037,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGDISP_MENU:
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGREGN_MENU,
-		    MODE_CFGDISP_SETBRIGHT_MENU,
-		    NULL,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGDISP_SETBRIGHT_MENU: ;
-	    void menu_cfgdisp_setbright_init(void) {
-#ifdef AUTOMATIC_DIMMER
-		mode.tmp[MODE_TMP_MIN] = display.bright_min;
-		mode.tmp[MODE_TMP_MAX] = display.bright_max;
-
-		if(display.bright_min == display.bright_max) {
-		    *mode.tmp = display.bright_min;
-		} else {
-		    *mode.tmp = 11;
-		}
-#endif  // AUTOMATIC_DIMMER
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifndef SEGMENT_MULTIPLEXING
-		    MODE_CFGDISP_SETDIGITBRIGHT_MENU,
-#else
-		    MODE_CFGDISP_SETAUTOOFF_MENU,
-#endif  // ~ SEGMENT_MULTIPLEXING
-		    MODE_CFGDISP_SETBRIGHT_LEVEL,
-		    menu_cfgdisp_setbright_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGDISP_SETBRIGHT_LEVEL:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -1002,291 +1116,117 @@ void mode_semitick(void) {
 	case MODE_CFGDISP_SETBRIGHT_MAX:
 	    switch(btn) {
 		case BUTTONS_MENU:
-		    display_loadbright();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    display.bright_min = mode.tmp[MODE_TMP_MIN];
-		    display.bright_max = *mode.tmp;
-		    display_savebright();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    if(++(*mode.tmp) > 20) {
-		        if(mode.tmp[MODE_TMP_MIN] < 1) {
-			    *mode.tmp = 1;
-			} else {
-			    *mode.tmp = mode.tmp[MODE_TMP_MIN] + 1;
-			}
-		    }
-
-		    mode_update(MODE_CFGDISP_SETBRIGHT_MAX,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    if(mode.timer == MODE_TIMEOUT) {
-			display_loadbright();
-		    }
-		    break;
-	    }
-	    break;
-#endif  // AUTOMATIC_DIMMER
-#ifndef SEGMENT_MULTIPLEXING
-	case MODE_CFGDISP_SETDIGITBRIGHT_MENU: ;
-	    void menu_cfgdisp_setdigitbright_init(void) {
-		*mode.tmp = 0;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGDISP_SETAUTOOFF_MENU,
-		    MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
-		    menu_cfgdisp_setdigitbright_init,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGDISP_SETDIGITBRIGHT_LEVEL:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    display_loaddigittimes();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    if(++(*mode.tmp) < DISPLAY_SIZE) {
-			mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
-				    DISPLAY_TRANS_INSTANT);
-		    } else {
-			mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-			display_savedigittimes();
-		    }
-		    break;
-		case BUTTONS_PLUS:
-		    if(display.digit_times[*mode.tmp] < 240) {
-			display.digit_times[*mode.tmp] +=
-					display.digit_times[*mode.tmp] / 5;
-		    } else {
-			display.digit_times[*mode.tmp] = 15;
-		    }
-
-		    display_noflicker();
-
-		    mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		case (BUTTONS_SET | BUTTONS_PLUS):
-		    display.digit_times[*mode.tmp] = 15;
-
-		    display_noflicker();
-
-		    mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		case (BUTTONS_MENU | BUTTONS_PLUS):
-		    for(*mode.tmp=0; *mode.tmp<DISPLAY_SIZE; ++(*mode.tmp)) {
-			display.digit_times[*mode.tmp] = 15;
-		    }
-
-		    *mode.tmp = 0;
-
-		    display_noflicker();
-
-		    mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    if(mode.timer == MODE_TIMEOUT) {
-			display_loaddigittimes();
-		    }
-		    break;
-	    }
-	    break;
-#endif  // ~SEGMENT_MULTIPLEXING
-	case MODE_CFGDISP_SETAUTOOFF_MENU:
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGDISP_SETANIMATED_MENU,
-#ifdef AUTOMATIC_DIMMER
-		    MODE_CFGDISP_SETPHOTOOFF_MENU,
-#else
-		    MODE_CFGDISP_SETOFFTIME_MENU,
-#endif
-		    NULL, btn, FALSE);
-	    break;
-#ifdef AUTOMATIC_DIMMER
-	case MODE_CFGDISP_SETPHOTOOFF_MENU: ;
-	    void menu_cfgdisp_setphotooff_init(void) {
-		uint8_t off_thr = display.off_threshold;
-		for(*mode.tmp = 0; off_thr; off_thr >>= 1) ++(*mode.tmp);
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGDISP_SETOFFTIME_MENU,
-		    MODE_CFGDISP_SETPHOTOOFF_THRESH,
-		    menu_cfgdisp_setphotooff_init,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGDISP_SETPHOTOOFF_THRESH:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    display.off_threshold = (*mode.tmp ? (1<<(*mode.tmp-1)) : 0);
-		    display_savephotooff();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    ++(*mode.tmp);
-		    if(*mode.tmp > 8) *mode.tmp = 0;
-		    mode_update(MODE_CFGDISP_SETPHOTOOFF_THRESH,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-#endif  // AUTOMATIC_DIMMER
-	case MODE_CFGDISP_SETOFFTIME_MENU: ;
-	    void menu_cfgdisp_setofftime_init(void) {
-		*mode.tmp = display.off_hour & _BV(TIME_NODAY);
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGDISP_SETOFFDAYS_MENU,
-		    MODE_CFGDISP_SETOFFTIME_TOGGLE,
-		    menu_cfgdisp_setofftime_init,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGDISP_SETOFFTIME_TOGGLE:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    if(*mode.tmp) {
-			display.off_hour |= _BV(TIME_NODAY);
-			display_saveofftime();
-			mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    } else {
-			display.off_hour &= ~_BV(TIME_NODAY);
-			mode_update(MODE_CFGDISP_SETOFFTIME_OFFHOUR,
-				    DISPLAY_TRANS_DOWN);
-		    }
-		    break;
-		case BUTTONS_PLUS:
-		    *mode.tmp ^= _BV(TIME_NODAY);
-		    mode_update(MODE_CFGDISP_SETOFFTIME_TOGGLE,
-				DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_CFGDISP_SETOFFTIME_OFFHOUR:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    display_loadofftime();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    mode_update(MODE_CFGDISP_SETOFFTIME_OFFMINUTE,
-				DISPLAY_TRANS_INSTANT);
-		    break;
-		case BUTTONS_PLUS:
-		    ++display.off_hour;
-		    display.off_hour %= 24;
-		    mode_update(MODE_CFGDISP_SETOFFTIME_OFFHOUR,
-				DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    if(mode.timer == MODE_TIMEOUT) {
-			display_loadofftime();
-		    }
-		    break;
-	    }
-	    break;
-	case MODE_CFGDISP_SETOFFTIME_OFFMINUTE:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    display_loadofftime();
+		    display_loadbright();
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
-		    mode_update(MODE_CFGDISP_SETOFFTIME_ONHOUR,
-				DISPLAY_TRANS_UP);
+		    display.bright_min = mode.tmp[MODE_TMP_MIN];
+		    display.bright_max = *mode.tmp;
+		    display_savebright();
+		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
 		    break;
 		case BUTTONS_PLUS:
-		    ++display.off_minute;
-		    display.off_minute %= 60;
-		    mode_update(MODE_CFGDISP_SETOFFTIME_OFFMINUTE,
+		    if(++(*mode.tmp) > 20) {
+		        if(mode.tmp[MODE_TMP_MIN] < 1) {
+			    *mode.tmp = 1;
+			} else {
+			    *mode.tmp = mode.tmp[MODE_TMP_MIN] + 1;
+			}
+		    }
+
+		    mode_update(MODE_CFGDISP_SETBRIGHT_MAX,
 			        DISPLAY_TRANS_INSTANT);
 		    break;
 		default:
 		    if(mode.timer == MODE_TIMEOUT) {
-			display_loadofftime();
+			display_loadbright();
 		    }
 		    break;
 	    }
 	    break;
-	case MODE_CFGDISP_SETOFFTIME_ONHOUR:
+#endif  // AUTOMATIC_DIMMER
+#ifndef SEGMENT_MULTIPLEXING
+	case MODE_CFGDISP_SETDIGITBRIGHT_LEVEL:
 	    switch(btn) {
 		case BUTTONS_MENU:
-		    display_loadofftime();
+		    display_loaddigittimes();
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
-		    mode_update(MODE_CFGDISP_SETOFFTIME_ONMINUTE,
-				DISPLAY_TRANS_INSTANT);
+		    if(++(*mode.tmp) < DISPLAY_SIZE) {
+			mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
+				    DISPLAY_TRANS_INSTANT);
+		    } else {
+			mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
+			display_savedigittimes();
+		    }
 		    break;
 		case BUTTONS_PLUS:
-		    ++display.on_hour;
-		    display.on_hour %= 24;
-		    mode_update(MODE_CFGDISP_SETOFFTIME_ONHOUR,
-				DISPLAY_TRANS_INSTANT);
+		    if(display.digit_times[*mode.tmp] < 240) {
+			display.digit_times[*mode.tmp] +=
+					display.digit_times[*mode.tmp] / 5;
+		    } else {
+			display.digit_times[*mode.tmp] = 15;
+		    }
+
+		    display_noflicker();
+
+		    mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
+			        DISPLAY_TRANS_INSTANT);
+		    break;
+		case (BUTTONS_SET | BUTTONS_PLUS):
+		    display.digit_times[*mode.tmp] = 15;
+
+		    display_noflicker();
+
+		    mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
+			        DISPLAY_TRANS_INSTANT);
+		    break;
+		case (BUTTONS_MENU | BUTTONS_PLUS):
+		    for(*mode.tmp=0; *mode.tmp<DISPLAY_SIZE; ++(*mode.tmp)) {
+			display.digit_times[*mode.tmp] = 15;
+		    }
+
+		    *mode.tmp = 0;
+
+		    display_noflicker();
+
+		    mode_update(MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
+			        DISPLAY_TRANS_INSTANT);
 		    break;
 		default:
 		    if(mode.timer == MODE_TIMEOUT) {
-			display_loadofftime();
+			display_loaddigittimes();
 		    }
 		    break;
 	    }
 	    break;
-	case MODE_CFGDISP_SETOFFTIME_ONMINUTE:
+#endif  // ~SEGMENT_MULTIPLEXING
+	case MODE_CFGDISP_SETOFFTIME_TOGGLE:
 	    switch(btn) {
 		case BUTTONS_MENU:
-		    display_loadofftime();
 		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
 		    break;
 		case BUTTONS_SET:
-		    display_saveofftime();
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
+		    if(*mode.tmp) {
+			display.off_hour |= _BV(TIME_NODAY);
+			display_saveofftime();
+			mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
+		    } else {
+			display.off_hour &= ~_BV(TIME_NODAY);
+			mode_update(MODE_CFGDISP_SETOFFTIME_OFFHOUR,
+				    DISPLAY_TRANS_DOWN);
+		    }
 		    break;
 		case BUTTONS_PLUS:
-		    ++display.on_minute;
-		    display.on_minute %= 60;
-		    mode_update(MODE_CFGDISP_SETOFFTIME_ONMINUTE,
-			        DISPLAY_TRANS_INSTANT);
+		    *mode.tmp ^= _BV(TIME_NODAY);
+		    mode_update(MODE_CFGDISP_SETOFFTIME_TOGGLE,
+				DISPLAY_TRANS_INSTANT);
 		    break;
 		default:
-		    if(mode.timer == MODE_TIMEOUT) {
-			display_loadofftime();
-		    }
 		    break;
 	    }
 	    break;
-	case MODE_CFGDISP_SETOFFDAYS_MENU: ;
-	    void menu_cfgdisp_setoffdays_init(void) {
-		*mode.tmp = display.off_days;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGDISP_SETONDAYS_MENU,
-		    MODE_CFGDISP_SETOFFDAYS_OPTIONS,
-		    menu_cfgdisp_setoffdays_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGDISP_SETOFFDAYS_OPTIONS:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -1366,22 +1306,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGDISP_SETONDAYS_MENU: ;
-	    void menu_cfgdisp_setondays_init(void) {
-		*mode.tmp = display.on_days;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifdef AUTOMATIC_DIMMER
-		    MODE_CFGDISP_SETPHOTOOFF_MENU,
-#else
-		    MODE_CFGDISP_SETOFFTIME_MENU,
-#endif  // AUTOMATIC_DIMMER
-		    MODE_CFGDISP_SETONDAYS_OPTIONS,
-		    menu_cfgdisp_setondays_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGDISP_SETONDAYS_OPTIONS:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -1461,22 +1385,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGDISP_SETANIMATED_MENU: ;
-	    void menu_cfgdisp_setanimated_init(void) {
-		*mode.tmp = display.status;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifdef ADAFRUIT_BUTTONS
-		    MODE_CFGDISP_MENU,
-#else
-		    MODE_CFGDISP_SETBRIGHT_MENU,
-#endif
-		    MODE_CFGDISP_SETANIMATED_TOGGLE,
-		    menu_cfgdisp_setanimated_init,
-		    btn, TRUE);
-	    break;
 	case MODE_CFGDISP_SETANIMATED_TOGGLE:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -1496,34 +1404,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGREGN_MENU:
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifdef ADAFRUIT_BUTTONS
-		    MODE_TIME_DISPLAY,
-#else
-		    MODE_SETALARM_MENU,
-#endif
-		    MODE_CFGREGN_SETDST_MENU,
-		    NULL,
-		    btn, TRUE);
-	    break;
-	case MODE_CFGREGN_SETDST_MENU: ;
-	    void menu_cfgregn_setdst_init(void) {
-		*mode.tmp = time.status;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifdef GPS_TIMEKEEPING
-		    MODE_CFGREGN_SETZONE_MENU,
-#else
-		    MODE_CFGREGN_TIMEFMT_MENU,
-#endif  // GPS_TIMEKEEPING
-		    MODE_CFGREGN_SETDST_STATE,
-		    menu_cfgregn_setdst_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGREGN_SETDST_STATE:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -1641,78 +1521,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-#ifdef GPS_TIMEKEEPING
-	case MODE_CFGREGN_SETZONE_MENU: ;
-	    void menu_cfgregn_setzone_init(void) {
-		mode.tmp[MODE_TMP_HOUR]   = gps.rel_utc_hour;
-		mode.tmp[MODE_TMP_MINUTE] = gps.rel_utc_minute;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGREGN_TIMEFMT_MENU,
-		    MODE_CFGREGN_SETZONE_HOUR,
-		    menu_cfgregn_setzone_init,
-		    btn, FALSE);
-	    break;
-	case MODE_CFGREGN_SETZONE_HOUR:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    mode_update(MODE_CFGREGN_SETZONE_MINUTE,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		case BUTTONS_PLUS:
-		    if(mode.tmp[MODE_TMP_HOUR] >= GPS_HOUR_OFFSET_MAX) {
-			mode.tmp[MODE_TMP_HOUR] = GPS_HOUR_OFFSET_MIN;
-		    } else {
-			++mode.tmp[MODE_TMP_HOUR];
-		    }
-		    mode_update(MODE_CFGREGN_SETZONE_HOUR,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-	case MODE_CFGREGN_SETZONE_MINUTE:
-	    switch(btn) {
-		case BUTTONS_MENU:
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
-		    break;
-		case BUTTONS_SET:
-		    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-			gps.rel_utc_hour   = mode.tmp[MODE_TMP_HOUR  ];
-			gps.rel_utc_minute = mode.tmp[MODE_TMP_MINUTE];
-			gps_saverelutc();
-		    }
-		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
-		    break;
-		case BUTTONS_PLUS:
-		    ++mode.tmp[MODE_TMP_MINUTE];
-		    mode.tmp[MODE_TMP_MINUTE] %= 60;
-		    mode_update(MODE_CFGREGN_SETZONE_MINUTE,
-			        DISPLAY_TRANS_INSTANT);
-		    break;
-		default:
-		    break;
-	    }
-	    break;
-#endif  // GPS_TIMEKEEPING
-	case MODE_CFGREGN_TIMEFMT_MENU: ;
-	    void menu_cfgregn_set12hour_init(void) {
-		*mode.tmp = time.timeformat_flags;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGREGN_DATEFMT_MENU,
-		    MODE_CFGREGN_TIMEFMT_12HOUR,
-		    menu_cfgregn_set12hour_init,
-		    btn, FALSE);
-	    break;
 	case MODE_CFGREGN_TIMEFMT_12HOUR:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -1931,17 +1739,6 @@ void mode_semitick(void) {
 	    }
 	    break;
 #endif  // GPS_TIMEKEEPING
-	case MODE_CFGREGN_DATEFMT_MENU: ;
-	    void menu_cfgregn_datefmt(void) {
-		*mode.tmp = time.dateformat;
-	    }
-
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-		    MODE_CFGREGN_MISCFMT_MENU,
-		    MODE_CFGREGN_DATEFMT_SHOWWDAY,
-		    menu_cfgregn_datefmt, btn, FALSE);
-	    break;
 	case MODE_CFGREGN_DATEFMT_SHOWWDAY:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -2064,18 +1861,6 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
-	case MODE_CFGREGN_MISCFMT_MENU: ;
-	    mode_menu_process_button(
-		    MODE_TIME_DISPLAY,
-#ifdef ADAFRUIT_BUTTONS
-		    MODE_CFGREGN_MENU,
-#else
-		    MODE_CFGREGN_SETDST_MENU,
-#endif
-		    MODE_CFGREGN_MISCFMT_ZEROPAD,
-		    NULL,
-		    btn, TRUE);
-	    break;
 	case MODE_CFGREGN_MISCFMT_ZEROPAD:
 	    switch(btn) {
 		case BUTTONS_MENU:
@@ -2142,7 +1927,47 @@ void mode_semitick(void) {
 		    break;
 	    }
 	    break;
+#ifdef BATTERY_GAUGE
+	case MODE_BATTERY_VOLTAGE:
+	case MODE_BATTERY_LEVEL:
+	case MODE_BATTERY_DAYS:
+	    switch(btn) {
+		case BUTTONS_MENU:
+		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
+		    break;
+		case BUTTONS_SET:
+		case BUTTONS_PLUS:
+		    if(mode.state == MODE_BATTERY_DAYS) *mode.tmp = FALSE;
+		    mode_update(mode.state + 1, DISPLAY_TRANS_UP);
+		    break;
+		default:
+		    break;
+	    }
+	    break;
+	case MODE_BATTERY_RESET:
+	    switch(btn) {
+		case BUTTONS_MENU:
+		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
+		    break;
+		case BUTTONS_SET:
+		    if(*mode.tmp) system_gauge_reset();
+		    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_UP);
+		    break;
+		case BUTTONS_PLUS:
+		    *mode.tmp = !*mode.tmp;
+		    mode_update(MODE_BATTERY_RESET, DISPLAY_TRANS_INSTANT);
+		    break;
+		default:
+		    break;
+	    }
+	    break;
+#endif  // BATTERY_GAUGE
 	default:
+	    if(mode_edit_find(mode.state)) {
+		mode_edit_process(mode.state, btn);
+	    } else {
+		mode_menu_process(mode.state, btn);
+	    }
 	    break;
     }
 
@@ -2188,6 +2013,11 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
     mode.timer = 0;
     mode.state = new_state;
 
+#ifndef SEGMENT_MULTIPLEXING
+    // hold button presses for chords only where chords are used
+    buttons.chord_hold = (new_state == MODE_CFGDISP_SETDIGITBRIGHT_LEVEL);
+#endif  // ~SEGMENT_MULTIPLEXING
+
     display_clearall();
 
     switch(mode.state) {
@@ -2244,9 +2074,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	case MODE_SNOOZEON_DISPLAY:
 	    display_pstr(0, PSTR("snoozing"));
 	    break;
-	case MODE_SETALARM_MENU:
-	    display_pstr(0, PSTR("set alar"));
-	    break;
 	case MODE_SETALARM_IDX:
 	    display_pstr(0, PSTR("alarm"));
 	    display_twodigit_leftadj(7, *mode.tmp + 1);
@@ -2298,9 +2125,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    mode_daysofweek_display(mode.tmp[MODE_TMP_DAYS]);
 	    display_dot(1 + mode.tmp[MODE_TMP_IDX], TRUE);
 	    break;
-	case MODE_SETTIME_MENU:
-	    display_pstr(0, PSTR("set time"));
-	    break;
 	case MODE_SETTIME_HOUR:
 	    mode_settime_display(mode.tmp[MODE_TMP_HOUR],
 		                 mode.tmp[MODE_TMP_MINUTE],
@@ -2319,9 +2143,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 			         mode.tmp[MODE_TMP_SECOND]);
 	    display_dotselect(7, 8);
 	    break;
-	case MODE_SETDATE_MENU:
-	    display_pstr(0, PSTR("set date"));
-	    break;
 	case MODE_SETDATE_YEAR:
 	    display_twodigit_zeropad(1, 20);
 	    display_twodigit_zeropad(3, mode.tmp[MODE_TMP_YEAR]);
@@ -2341,21 +2162,10 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    display_twodigit_rightadj(5, mode.tmp[MODE_TMP_DAY]);
 	    display_dotselect(5, 6);
 	    break;
-	case MODE_CFGALARM_MENU:
-	    display_pstr(0, PSTR("cfg alar"));
-	    break;
-	case MODE_CFGALARM_SETSOUND_MENU:
-	    display_pstr(0, PSTR("a sound"));
-	    display_dot(1, TRUE);
-	    break;
 	case MODE_CFGALARM_SETSOUND:
 	    display_pstr(0, piezo_pstr());
 	    display_dotselect(1, 8);
 	    break;
-	case MODE_CFGALARM_SETVOL_MENU:
-	    display_pstr(0, PSTR("a volume"));
-	    display_dot(1, TRUE);
-	    break;
 	case MODE_CFGALARM_SETVOL:
 	    pstr_ptr = PSTR("vol");
 	    if(*mode.tmp == 11) {
@@ -2375,10 +2185,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	case MODE_CFGALARM_SETVOL_TIME:
 	    mode_textnum_display(PSTR("time"), *mode.tmp);
 	    break;
-	case MODE_CFGALARM_SETSNOOZE_MENU:
-	    display_pstr(0, PSTR("a snooze"));
-	    display_dot(1, TRUE);
-	    break;
 	case MODE_CFGALARM_SETSNOOZE_TIME:
 	    pstr_ptr = PSTR("snoz");
 	    if(*mode.tmp) {
@@ -2388,10 +2194,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 		display_dotselect(6, 8);
 	    }
 	    break;
-	case MODE_CFGALARM_SETHEARTBEAT_MENU:
-	    display_pstr(0, PSTR("a pulse "));
-	    display_dot(1, TRUE);
-	    break;
 	case MODE_CFGALARM_SETHEARTBEAT_TOGGLE:
 	    switch(*mode.tmp) {
 		case ALARM_SOUNDING_PULSE | ALARM_SNOOZING_PULSE:
@@ -2409,12 +2211,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    }
 	    mode_texttext_display(PSTR("puls"), pstr_ptr);
 	    break;
-	case MODE_CFGDISP_MENU:
-	    display_pstr(0, PSTR("cfg disp"));
-	    break;
-	case MODE_CFGDISP_SETBRIGHT_MENU:
-	    display_pstr(0, PSTR("disp bri"));
-	    break;
 	case MODE_CFGDISP_SETBRIGHT_LEVEL:
 #ifdef AUTOMATIC_DIMMER
 	    if(*mode.tmp == 11) {
@@ -2450,9 +2246,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    break;
 #endif  // AUTOMATIC_DIMMER
 #ifndef SEGMENT_MULTIPLEXING
-	case MODE_CFGDISP_SETDIGITBRIGHT_MENU:
-	    display_pstr(0, PSTR("digt bri"));
-	    break;
 	case MODE_CFGDISP_SETDIGITBRIGHT_LEVEL:
 	    display_dot(0, TRUE);
 
@@ -2469,13 +2262,7 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 
 	    break;
 #endif  // ~SEGMENT_MULTIPLEXING
-	case MODE_CFGDISP_SETAUTOOFF_MENU:
-	    display_pstr(0, PSTR("auto off"));
-	    break;
 #ifdef AUTOMATIC_DIMMER
-	case MODE_CFGDISP_SETPHOTOOFF_MENU:
-	    display_pstr(0, PSTR("off dark"));
-	    break;
 	case MODE_CFGDISP_SETPHOTOOFF_THRESH:
 	    if(*mode.tmp) {
 		mode_textnum_display(PSTR("thrsh"), *mode.tmp);
@@ -2485,9 +2272,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    }
 	    break;
 #endif  // AUTOMATIC_DIMMER
-	case MODE_CFGDISP_SETOFFTIME_MENU:
-	    display_pstr(0, PSTR("off time"));
-	    break;
 	case MODE_CFGDISP_SETOFFTIME_TOGGLE:
 	    if(*mode.tmp) {
 		display_pstr(0, PSTR("disabled"));
@@ -2532,12 +2316,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 		display_dotselect(5, 6);
 	    }
 	    break;
-	case MODE_CFGDISP_SETOFFDAYS_MENU:
-	    display_pstr(0, PSTR("off days"));
-	    break;
-	case MODE_CFGDISP_SETONDAYS_MENU:
-	    display_pstr(0, PSTR("on days "));
-	    break;
 	case MODE_CFGDISP_SETOFFDAYS_OPTIONS:
 	case MODE_CFGDISP_SETONDAYS_OPTIONS:
 	    switch((uint8_t)*mode.tmp) {
@@ -2564,9 +2342,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    mode_daysofweek_display(*mode.tmp);
 	    display_dot(1 + mode.tmp[MODE_TMP_IDX], TRUE);
 	    break;
-	case MODE_CFGDISP_SETANIMATED_MENU:
-	    display_pstr(0, PSTR("animated"));
-	    break;
 	case MODE_CFGDISP_SETANIMATED_TOGGLE:
 	    if(*mode.tmp & DISPLAY_ANIMATED) {
 		pstr_ptr = PSTR("on");
@@ -2575,12 +2350,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    }
 	    mode_texttext_display(PSTR("anim"), pstr_ptr);
 	    break;
-	case MODE_CFGREGN_MENU:
-	    display_pstr(0, PSTR("cfg regn"));
-	    break;
-	case MODE_CFGREGN_SETDST_MENU:
-	    display_pstr(0, PSTR("set dst"));
-	    break;
 	case MODE_CFGREGN_SETDST_STATE:
 	    switch(*mode.tmp & TIME_AUTODST_MASK) {
 		case TIME_AUTODST_USA:
@@ -2617,9 +2386,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    mode_texttext_display(PSTR("zone"), pstr_ptr);
 	    break;
 #ifdef GPS_TIMEKEEPING
-	case MODE_CFGREGN_SETZONE_MENU:
-	    display_pstr(0, PSTR("set zone"));
-	    break;
 	case MODE_CFGREGN_SETZONE_HOUR:
 	    mode_zone_display();
 	    display_dotselect(2, 3);
@@ -2629,9 +2395,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    display_dotselect(6, 7);
 	    break;
 #endif  // GPS_TIMEKEEPING
-	case MODE_CFGREGN_TIMEFMT_MENU:
-	    display_pstr(0, PSTR("time fmt"));
-	    break;
 	case MODE_CFGREGN_TIMEFMT_12HOUR:
 	    mode_textnum_display(PSTR("hours"),
 		    (*mode.tmp & TIME_TIMEFORMAT_12HOUR ? 12 : 24));
@@ -2664,9 +2427,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	    }
 	    break;
 #endif  // GPS_TIMEKEEPING
-	case MODE_CFGREGN_DATEFMT_MENU:
-	    display_pstr(0, PSTR("date fmt"));
-	    break;
 	case MODE_CFGREGN_DATEFMT_SHOWWDAY:
 	    if(*mode.tmp & TIME_DATEFORMAT_SHOWWDAY) {
 		pstr_ptr = PSTR("on");
@@ -2696,9 +2456,6 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 		mode_texttext_display(pstr_ptr, PSTR("off"));
 	    }
 	    break;
-	case MODE_CFGREGN_MISCFMT_MENU:
-	    display_pstr(0, PSTR("misc fmt"));
-	    break;
 	case MODE_CFGREGN_MISCFMT_ZEROPAD:
 	    mode_textnum_display(PSTR("zero"), 0);
 	    break;
@@ -2708,8 +2465,29 @@ void mode_update(uint8_t new_state, uint8_t disp_trans) {
 	case MODE_CFGREGN_MISCFMT_ALTALPHA:
 	    mode_texttext_display(PSTR("char"), PSTR("eg"));
 	    break;
+#ifdef BATTERY_GAUGE
+	case MODE_BATTERY_VOLTAGE: ;
+	    uint16_t mv = system_gauge_voltage();
+	    if(mv) {
+		mode_threedigit_display(PSTR("volt"), mv / 10);
+		display_dot(6, TRUE);
+	    } else {
+		mode_texttext_display(PSTR("volt"), PSTR("--"));
+	    }
+	    break;
+	case MODE_BATTERY_LEVEL:
+	    mode_threedigit_display(PSTR("left"), system_gauge_level());
+	    break;
+	case MODE_BATTERY_DAYS:
+	    mode_threedigit_display(PSTR("days"), system_gauge_days());
+	    break;
+	case MODE_BATTERY_RESET:
+	    mode_texttext_display(PSTR("new"),
+		                  *mode.tmp ? PSTR("yes") : PSTR("no"));
+	    break;
+#endif  // BATTERY_GAUGE
 	default:
-	    display_pstr(0, PSTR("-error-"));
+	    mode_menu_display(mode.state);
 	    break;
     }
 
@@ -2948,6 +2726,18 @@ void mode_texttext_display(PGM_P label, PGM_P opt) {
 }
 
 
+#ifdef BATTERY_GAUGE
+// displays text with a read-only number up to 999
+void mode_threedigit_display(PGM_P label, uint16_t num) {
+    display_pstr(0, label);
+    if(num > 999) num = 999;
+    if(num >= 100) display_digit(6, num / 100);
+    if(num >= 10)  display_digit(7, num / 10 % 10);
+    display_digit(8, num % 10);
+}
+#endif  // BATTERY_GAUGE
+
+
 // displays current month and day
 void mode_monthday_display(void) {
     display_clear(0);
@@ -3022,15 +2812,39 @@ void mode_daysofweek_display(uint8_t days) {
 }
 
 
-// helper function to process button presses
-// for menu states in menu_semitick()
-void mode_menu_process_button(uint8_t up, uint8_t next, uint8_t down,
-			      void (*init_func)(void), uint8_t btn,
-			      uint8_t next_is_up) {
+// find the menu tree entry for state; returns NULL if state is not a menu
+const mode_menu_t *mode_menu_find(uint8_t state) {
+    uint8_t idx = state - MODE_MENU_FIRST;
+    return idx < MODE_MENU_COUNT ? &mode_menus[idx] : NULL;
+}
+
+
+// find the value setting for state; returns NULL if state is not a value
+const mode_edit_t *mode_edit_find(uint8_t state) {
+    uint8_t idx = state - MODE_EDIT_FIRST;
+    return idx < MODE_EDIT_COUNT ? &mode_edits[idx] : NULL;
+}
+
+
+// process button presses for menu states in mode_semitick()
+void mode_menu_process(uint8_t state, uint8_t btn) {
+    const mode_menu_t *menu = mode_menu_find(state);
+    if(!menu) return;
+
+    uint8_t up   = pgm_read_byte(&menu->up);
+    uint8_t next = pgm_read_byte(&menu->next);
+
+#ifdef GPS_TIMEKEEPING
+    // skip time and date menus while gps provides the time
+    if(next == MODE_SETTIME_MENU && gps.status & GPS_SIGNAL_GOOD) {
+	next = MODE_CFGALARM_MENU;
+    }
+#endif  // GPS_TIMEKEEPING
+
     switch(btn) {
 	case BUTTONS_MENU:
 #ifdef ADAFRUIT_BUTTONS
-	    if(next_is_up) {
+	    if(pgm_read_byte(&menu->flags) & MODE_MENU_LAST) {
 		mode_update(next, DISPLAY_TRANS_DOWN);
 	    } else {
 		mode_update(next, DISPLAY_TRANS_LEFT);
@@ -3039,9 +2853,10 @@ void mode_menu_process_button(uint8_t up, uint8_t next, uint8_t down,
 	    mode_update(up, DISPLAY_TRANS_DOWN);
 #endif
 	    break;
-	case BUTTONS_SET:
+	case BUTTONS_SET: ;
+	    void (*init_func)(void) = (void (*)(void))pgm_read_word(&menu->init);
 	    if(init_func) init_func();
-	    mode_update(down, DISPLAY_TRANS_UP);
+	    mode_update(pgm_read_byte(&menu->down), DISPLAY_TRANS_UP);
 	    break;
 	case BUTTONS_PLUS:
 #ifdef ADAFRUIT_BUTTONS
@@ -3054,3 +2869,56 @@ void mode_menu_process_button(uint8_t up, uint8_t next, uint8_t down,
 	    break;
     }
 }
+
+
+// process button presses for value states in mode_semitick()
+void mode_edit_process(uint8_t state, uint8_t btn) {
+    const mode_edit_t *edit = mode_edit_find(state);
+
+    volatile int8_t *value = (volatile int8_t *)pgm_read_word(&edit->value);
+    void (*load_func)(void) = (void (*)(void))pgm_read_word(&edit->load);
+
+    switch(btn) {
+	case BUTTONS_MENU:
+	    if(load_func) load_func();
+	    mode_update(MODE_TIME_DISPLAY, DISPLAY_TRANS_DOWN);
+	    break;
+	case BUTTONS_SET: ;
+	    void (*save_func)(void) = (void (*)(void))pgm_read_word(&edit->save);
+	    if(save_func) save_func();
+	    mode_update(pgm_read_byte(&edit->next),
+		        pgm_read_byte(&edit->trans));
+	    break;
+	case BUTTONS_PLUS: ;
+	    int8_t max = pgm_read_byte(&edit->max);
+	    if(pgm_read_byte(&edit->flags) & MODE_EDIT_MONTHDAYS) {
+		max = time_daysinmonth(mode.tmp[MODE_TMP_YEAR],
+				       mode.tmp[MODE_TMP_MONTH]);
+	    }
+
+	    if(*value >= max) {
+		*value = pgm_read_byte(&edit->min);
+	    } else {
+		++(*value);
+	    }
+
+	    mode_update(state, DISPLAY_TRANS_INSTANT);
+	    break;
+	default:
+	    if(mode.timer == MODE_TIMEOUT && load_func) load_func();
+	    break;
+    }
+}
+
+
+// display the label for menu states in mode_update()
+void mode_menu_display(uint8_t state) {
+    const mode_menu_t *menu = mode_menu_find(state);
+
+    if(menu) {
+	display_pstr(0, menu->label);
+	if(pgm_read_byte(&menu->flags) & MODE_MENU_DOT) display_dot(1, TRUE);
+    } else {
+	display_pstr(0, PSTR("-error-"));
+    }
+}
@@ -3,14 +3,17 @@
 
 #include <stdint.h>  // for using standard integer types
 
-#include "config.h"  // for configuration macros
+#include "config.h"   // for configuration macros
+#include "display.h"  // for DISPLAY_SIZE
 
 
 // default menu timeout; on timeout, mode changes to time display
 #define MODE_TIMEOUT 30000  // semiticks (~milliseconds)
 
-// various clock modes; current mode given by mode.state
+// various clock modes; current mode given by mode.state.  states are
+// grouped so that menus and value settings index their tables directly
 enum {
+    // time display states, which alarm events may interrupt
     MODE_TIME_DISPLAY,
         MODE_DAYOFWEEK_DISPLAY,
         MODE_MONTHDAY_DISPLAY,
@@ -21,92 +24,153 @@ enum {
         MODE_ALARMDAYS_DISPLAY,
         MODE_ALARMOFF_DISPLAY,
         MODE_SNOOZEON_DISPLAY,
+
+    // menus that only lead to other states (mode_menus[] in mode.c)
     MODE_SETALARM_MENU,
-	MODE_SETALARM_IDX,
-	MODE_SETALARM_ENABLE,
-        MODE_SETALARM_HOUR,
-        MODE_SETALARM_MINUTE,
-        MODE_SETALARM_DAYS_OPTIONS,
-        MODE_SETALARM_DAYS_CUSTOM,
     MODE_SETTIME_MENU,
-        MODE_SETTIME_HOUR,
-        MODE_SETTIME_MINUTE,
-        MODE_SETTIME_SECOND,
     MODE_SETDATE_MENU,
-        MODE_SETDATE_YEAR,
-        MODE_SETDATE_MONTH,
-        MODE_SETDATE_DAY,
     MODE_CFGALARM_MENU,
 	MODE_CFGALARM_SETSOUND_MENU,
-	    MODE_CFGALARM_SETSOUND,
 	MODE_CFGALARM_SETVOL_MENU,
-	    MODE_CFGALARM_SETVOL,
-	    MODE_CFGALARM_SETVOL_MIN,
-	    MODE_CFGALARM_SETVOL_MAX,
-	    MODE_CFGALARM_SETVOL_TIME,
 	MODE_CFGALARM_SETSNOOZE_MENU,
-	    MODE_CFGALARM_SETSNOOZE_TIME,
 	MODE_CFGALARM_SETHEARTBEAT_MENU,
-	    MODE_CFGALARM_SETHEARTBEAT_TOGGLE,
     MODE_CFGDISP_MENU,
 	MODE_CFGDISP_SETBRIGHT_MENU,
-	    MODE_CFGDISP_SETBRIGHT_LEVEL,
-#ifdef AUTOMATIC_DIMMER
-	    MODE_CFGDISP_SETBRIGHT_MIN,
-	    MODE_CFGDISP_SETBRIGHT_MAX,
-#endif  // AUTOMATIC_DIMMER
 #ifndef SEGMENT_MULTIPLEXING
 	MODE_CFGDISP_SETDIGITBRIGHT_MENU,
-	    MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
 #endif  // ~SEGMENT_MULTIPLEXING
 	MODE_CFGDISP_SETAUTOOFF_MENU,
 #ifdef AUTOMATIC_DIMMER
 	    MODE_CFGDISP_SETPHOTOOFF_MENU,
-	    MODE_CFGDISP_SETPHOTOOFF_THRESH,
 #endif  // AUTOMATIC_DIMMER
 	    MODE_CFGDISP_SETOFFTIME_MENU,
-		MODE_CFGDISP_SETOFFTIME_TOGGLE,
-		MODE_CFGDISP_SETOFFTIME_OFFHOUR,
-		MODE_CFGDISP_SETOFFTIME_OFFMINUTE,
-		MODE_CFGDISP_SETOFFTIME_ONHOUR,
-		MODE_CFGDISP_SETOFFTIME_ONMINUTE,
 	    MODE_CFGDISP_SETOFFDAYS_MENU,
-		MODE_CFGDISP_SETOFFDAYS_OPTIONS,
-		MODE_CFGDISP_SETOFFDAYS_CUSTOM,
 	    MODE_CFGDISP_SETONDAYS_MENU,
-		MODE_CFGDISP_SETONDAYS_OPTIONS,
-		MODE_CFGDISP_SETONDAYS_CUSTOM,
 	MODE_CFGDISP_SETANIMATED_MENU,
-	    MODE_CFGDISP_SETANIMATED_TOGGLE,
     MODE_CFGREGN_MENU,
 	MODE_CFGREGN_SETDST_MENU,
-	    MODE_CFGREGN_SETDST_STATE,
-	    MODE_CFGREGN_SETDST_ZONE,
 #ifdef GPS_TIMEKEEPING
 	MODE_CFGREGN_SETZONE_MENU,
-	    MODE_CFGREGN_SETZONE_HOUR,
-	    MODE_CFGREGN_SETZONE_MINUTE,
 #endif  // GPS_TIMEKEEPING
 	MODE_CFGREGN_TIMEFMT_MENU,
-	    MODE_CFGREGN_TIMEFMT_12HOUR,
-	    MODE_CFGREGN_TIMEFMT_FORMAT,
-	    MODE_CFGREGN_TIMEFMT_COLON,
-	    MODE_CFGREGN_TIMEFMT_DOT,
-	    MODE_CFGREGN_TIMEFMT_SHOWDST,
-#ifdef GPS_TIMEKEEPING
-	    MODE_CFGREGN_TIMEFMT_SHOWGPS,
-#endif  // GPS_TIMEKEEPING
 	MODE_CFGREGN_DATEFMT_MENU,
-	    MODE_CFGREGN_DATEFMT_SHOWWDAY,
-	    MODE_CFGREGN_DATEFMT_FORMAT,
-	    MODE_CFGREGN_DATEFMT_SHOWYEAR,
-	    MODE_CFGREGN_DATEFMT_AUTOSCROLL,
 	MODE_CFGREGN_MISCFMT_MENU,
-	    MODE_CFGREGN_MISCFMT_ZEROPAD,
-	    MODE_CFGREGN_MISCFMT_ALTNINE,
-	    MODE_CFGREGN_MISCFMT_ALTALPHA,
+#ifdef BATTERY_GAUGE
+    MODE_BATTERY_MENU,
+#endif  // BATTERY_GAUGE
+
+    // values stepped through a range (mode_edits[] in mode.c)
+    MODE_SETTIME_HOUR,
+    MODE_SETTIME_MINUTE,
+    MODE_SETTIME_SECOND,
+    MODE_SETDATE_YEAR,
+    MODE_SETDATE_MONTH,
+    MODE_SETDATE_DAY,
+    MODE_CFGALARM_SETVOL_TIME,
+    MODE_CFGALARM_SETSNOOZE_TIME,
+#ifdef AUTOMATIC_DIMMER
+    MODE_CFGDISP_SETPHOTOOFF_THRESH,
+#endif  // AUTOMATIC_DIMMER
+    MODE_CFGDISP_SETOFFTIME_OFFHOUR,
+    MODE_CFGDISP_SETOFFTIME_OFFMINUTE,
+    MODE_CFGDISP_SETOFFTIME_ONHOUR,
+    MODE_CFGDISP_SETOFFTIME_ONMINUTE,
+#ifdef GPS_TIMEKEEPING
+    MODE_CFGREGN_SETZONE_HOUR,
+    MODE_CFGREGN_SETZONE_MINUTE,
+#endif  // GPS_TIMEKEEPING
+
+    // states handled by mode_semitick() and mode_update()
+    MODE_SETALARM_IDX,
+    MODE_SETALARM_ENABLE,
+    MODE_SETALARM_HOUR,
+    MODE_SETALARM_MINUTE,
+    MODE_SETALARM_DAYS_OPTIONS,
+    MODE_SETALARM_DAYS_CUSTOM,
+    MODE_CFGALARM_SETSOUND,
+    MODE_CFGALARM_SETVOL,
+    MODE_CFGALARM_SETVOL_MIN,
+    MODE_CFGALARM_SETVOL_MAX,
+    MODE_CFGALARM_SETHEARTBEAT_TOGGLE,
+    MODE_CFGDISP_SETBRIGHT_LEVEL,
+#ifdef AUTOMATIC_DIMMER
+    MODE_CFGDISP_SETBRIGHT_MIN,
+    MODE_CFGDISP_SETBRIGHT_MAX,
+#endif  // AUTOMATIC_DIMMER
+#ifndef SEGMENT_MULTIPLEXING
+    MODE_CFGDISP_SETDIGITBRIGHT_LEVEL,
+#endif  // ~SEGMENT_MULTIPLEXING
+    MODE_CFGDISP_SETOFFTIME_TOGGLE,
+    MODE_CFGDISP_SETOFFDAYS_OPTIONS,
+    MODE_CFGDISP_SETOFFDAYS_CUSTOM,
+    MODE_CFGDISP_SETONDAYS_OPTIONS,
+    MODE_CFGDISP_SETONDAYS_CUSTOM,
+    MODE_CFGDISP_SETANIMATED_TOGGLE,
+    MODE_CFGREGN_SETDST_STATE,
+    MODE_CFGREGN_SETDST_ZONE,
+    MODE_CFGREGN_TIMEFMT_12HOUR,
+    MODE_CFGREGN_TIMEFMT_FORMAT,
+    MODE_CFGREGN_TIMEFMT_COLON,
+    MODE_CFGREGN_TIMEFMT_DOT,
+    MODE_CFGREGN_TIMEFMT_SHOWDST,
+#ifdef GPS_TIMEKEEPING
+    MODE_CFGREGN_TIMEFMT_SHOWGPS,
+#endif  // GPS_TIMEKEEPING
+    MODE_CFGREGN_DATEFMT_SHOWWDAY,
+    MODE_CFGREGN_DATEFMT_FORMAT,
+    MODE_CFGREGN_DATEFMT_SHOWYEAR,
+    MODE_CFGREGN_DATEFMT_AUTOSCROLL,
+    MODE_CFGREGN_MISCFMT_ZEROPAD,
+    MODE_CFGREGN_MISCFMT_ALTNINE,
+    MODE_CFGREGN_MISCFMT_ALTALPHA,
+#ifdef BATTERY_GAUGE
+    MODE_BATTERY_VOLTAGE,
+    MODE_BATTERY_LEVEL,
+    MODE_BATTERY_DAYS,
+    MODE_BATTERY_RESET,
+#endif  // BATTERY_GAUGE
 };
 
+// first state of each table-driven group above
+#define MODE_MENU_FIRST MODE_SETALARM_MENU
+#define MODE_EDIT_FIRST MODE_SETTIME_HOUR
+#define MODE_EDIT_END   MODE_SETALARM_IDX  // first state after the values
+
+#define MODE_MENU_COUNT (MODE_EDIT_FIRST - MODE_MENU_FIRST)
+#define MODE_EDIT_COUNT (MODE_EDIT_END   - MODE_EDIT_FIRST)
+
+
+// flags for mode_menu_t
+#define MODE_MENU_DOT  0x01  // show dot after first label character
+#define MODE_MENU_LAST 0x02  // last menu at its level
+
+// describes one menu in the menu tree; mode_menus[] is
+// indexed by state, from MODE_MENU_FIRST
+typedef struct {
+    char    label[DISPLAY_SIZE];  // menu label
+    uint8_t flags;                // menu flags
+    uint8_t up;                   // state after leaving the menu
+    uint8_t next;                 // state of next menu at same level
+    uint8_t down;                 // state after entering the menu
+    void (*init)(void);           // called before entering, or NULL
+} mode_menu_t;
+
+// flags for mode_edit_t
+#define MODE_EDIT_MONTHDAYS 0x01  // max is days in month being set
+
+// describes one value stepped through a range by the plus button;
+// mode_edits[] is indexed by state, from MODE_EDIT_FIRST
+typedef struct {
+    volatile int8_t *value;  // value being set
+    int8_t  min;             // value after max
+    int8_t  max;             // largest value
+    uint8_t flags;           // value flags
+    uint8_t next;            // state after the set button
+    uint8_t trans;           // display transition to next state
+    void (*save)(void);      // called by the set button, or NULL
+    void (*load)(void);      // called on cancel or timeout, or NULL
+} mode_edit_t;
+
 
 // status flag to be set when the display is about to transition
 // this flag may be cleared as soon as the display code takes
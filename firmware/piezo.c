@@ -340,6 +340,10 @@ void piezo_tick(void) {
 	    if(!(system.status & SYSTEM_SLEEP)) break;
 	case PIEZO_ALARM_BEEPS:
 	    if(++piezo.timer & 0x0001) {
+		// speed system clock before starting buzzer
+		system.status |= SYSTEM_ALARM_SOUNDING;
+		if(system.status & SYSTEM_SLEEP) system_sleep_clock();
+
 		switch(piezo.status & PIEZO_SOUND_MASK) {
 		    case PIEZO_SOUND_BEEPS_LOW:
 		    case PIEZO_SOUND_PULSE_LOW:
@@ -349,10 +353,10 @@ void piezo_tick(void) {
 			piezo_buzzeron(BEEP_HIGH(0));
 			break;
 		}
-		system.status |= SYSTEM_ALARM_SOUNDING;
 	    } else {
 		piezo_buzzeroff();
 		system.status &= ~SYSTEM_ALARM_SOUNDING;
+		if(system.status & SYSTEM_SLEEP) system_sleep_clock();
 	    }
 	    break;
 
@@ -700,6 +704,7 @@ void piezo_stop(void) {
     piezo.status  &= ~PIEZO_STATE_MASK;
     piezo.status  |=  PIEZO_INACTIVE;
     system.status &= ~SYSTEM_ALARM_SOUNDING;
+    if(system.status & SYSTEM_SLEEP) system_sleep_clock();
 }
 
 
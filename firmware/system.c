@@ -5,6 +5,9 @@
 //    PC1                  power from voltage regulator or unused pin
 //    AIN1 (PD7)           divided system voltage
 //    analog comparator    detects low voltage (AIN1)
+//    PCINT23 (PD7)        detects restored power during sleep
+//    watchdog interrupt   debounces restored power during sleep
+//    ADC (bandgap input)  measures battery voltage during sleep
 //
 // * PC2 is unused and configured with the pull-up resistor unless the
 //   IV-18 to-spec hack has been configured.
@@ -16,6 +19,7 @@
 
 
 #include <avr/interrupt.h> // for enabling and disabling interrupts
+#include <avr/eeprom.h>    // for battery gauge history
 #include <avr/power.h>     // for disabling microcontroller modules
 #include <avr/sleep.h>     // for entering low-power modes
 #include <avr/wdt.h>       // for using the watchdog timer
@@ -24,6 +28,8 @@
 
 
 #include "system.h"
+#include "time.h"   // for restoring timer2 after tickless sleep
+#include "gps.h"    // for sending queued gps configuration
 #include "usart.h"  // for debugging output
 #include "mode.h"   // to refresh time when clearing low battery warning
 
@@ -32,8 +38,24 @@
 volatile system_t system;
 
 
+#ifdef BATTERY_GAUGE
+// total seconds on battery power, excluding the current sleep
+uint32_t ee_system_gauge_seconds EEMEM = 0;
+
+// ring buffer of battery voltage measurements
+uint8_t ee_system_gauge_idx   EEMEM = 0;  // index of next record
+uint8_t ee_system_gauge_count EEMEM = 0;  // number of valid records
+system_gauge_t ee_system_gauge_history[SYSTEM_GAUGE_HISTORY] EEMEM;
+#endif  // BATTERY_GAUGE
+
+
 // private function declarations
 void system_check_battery(void);
+void system_debounce_sleep(void);
+uint16_t system_adc_sleep(void);
+#ifdef BATTERY_GAUGE
+void system_gauge_log(uint16_t mv);
+#endif  // BATTERY_GAUGE
 
 
 // enable low-power detection and disables microcontroller modules
@@ -43,6 +65,7 @@ void system_init(void) {
     wdt_enable(WDTO_8S);  // enable eight-second watchdog timer
 
     system.status &= ~SYSTEM_SLEEP;
+    system.battery_check = SYSTEM_BATTERY_CHECK_DELAY;
 
     // enable pull-up resistors on unused pins to ensure a defined value
 #if !defined(VFD_TO_SPEC) || defined(XMAS_DESIGN)
@@ -73,6 +96,7 @@ void system_init(void) {
 // when clock goes to sleep, restart sleep/wake timer
 void system_sleep(void) {
     system.sleep_wake_timer = 0;
+    system.battery_check = SYSTEM_BATTERY_CHECK_DELAY;
 }
 
 
@@ -86,6 +110,8 @@ void system_wake(void) {
 void system_idle_loop(void) {
     sleep_enable();
     for(;;) {
+	gps_idle();  // work deferred from interrupts
+
 	cli();
 	set_sleep_mode(SLEEP_MODE_IDLE);
 	sei();
@@ -112,7 +138,18 @@ void system_sleep_loop(void) {
     system.status |= SYSTEM_SLEEP;  // set sleep flag
     ACSR = _BV(ACD) | _BV(ACI);     // disable analog comparator and
     				    // clear analog comparator interrupt
+
+    // wake on pin change when power is restored; AIN1 is held at ground
+    // during sleep, so the digital input draws no additional current
+    DIDR1   = 0;
+    PCIFR   = _BV(PCIF2);
+    PCMSK2 |= _BV(PCINT23);
+    PCICR  |= _BV(PCIE2);
+
     do {
+	system.status &= ~SYSTEM_FAST_CLOCK;
+	system_sleep_clock();  // slow clock unless buzzer is active
+
 	do {
 	    // disable watchdog after five seconds to ensure
 	    // quartz crystal is running reasonably well
@@ -122,8 +159,14 @@ void system_sleep_loop(void) {
 	    }
 
 	    // check battery status after specified delay
-	    if(system.sleep_wake_timer == SYSTEM_BATTERY_CHECK_DELAY) {
+	    if(system.sleep_wake_timer == system.battery_check) {
+		// adc prescaler assumes a 2 MHz system clock, so the
+		// buzzer must not slow the clock during the check
+		system.status |= SYSTEM_FAST_CLOCK;
+		system_sleep_clock();
 		system_check_battery();
+		system.status &= ~SYSTEM_FAST_CLOCK;
+		system_sleep_clock();
 	    }
 
 	    // disable analog comparator to save power; analog comparator
@@ -156,23 +199,118 @@ void system_sleep_loop(void) {
 #endif  // __AVR_ATmega328P__
 	    }
 
-	    // analog comparator will have already been enabled
-	    // in the TIMER2_COMPB_vect interrupt (icetube.c)
+	    // analog comparator will have already been enabled in the
+	    // TIMER2_COMPB_vect interrupt (icetube.c) unless woken by a
+	    // pin change, so enable comparator and wait for the bandgap
+	    if(ACSR & _BV(ACD)) {
+		ACSR = _BV(ACBG);
+		_delay_us(20);  // at least 80 us because system
+				// clock is divided by four or more
+	    }
 	} while(system_power() == SYSTEM_BATTERY);
 
-	// debounce power-restored signal; delay is actually 100 ms
-	_delay_ms(25);  // because system clock is divided by four
+	// restore 2 MHz clock for debounce delay and wake functions
+	system.status |= SYSTEM_FAST_CLOCK;
+	system_sleep_clock();
+
+	// if woken by a pin change during a multi-second timer2 period,
+	// wait for the interrupt that ends the current second
+	uint32_t sleep_wake_timer = system.sleep_wake_timer;
+	if(time_tickless_shorten()) {
+	    while(system.sleep_wake_timer == sleep_wake_timer) {
+		sei();
+		sleep_cpu();
+		cli();
+	    }
+	}
+
+	// resume once-per-second interrupts while TCNT2 is still small
+	time_tickless_stop();
+
+	// debounce power-restored signal; if power is not restored, the
+	// watchdog must remain disabled once the delay above has passed
+	system_debounce_sleep();
+	if(system.sleep_wake_timer < SYSTEM_WDT_DISABLE_DELAY) {
+	    wdt_enable(WDTO_8S);
+	}
     } while(system_power() == SYSTEM_BATTERY);
 
     wdt_enable(WDTO_8S);
 
+#ifdef BATTERY_GAUGE
+    // add this sleep to total time on battery power
+    eeprom_update_dword(&ee_system_gauge_seconds,
+	    eeprom_read_dword(&ee_system_gauge_seconds)
+	    + system.sleep_wake_timer);
+#endif  // BATTERY_GAUGE
+
+    // disable pin change interrupt and digital input on AIN1
+    PCMSK2 &= ~_BV(PCINT23);
+    if(!PCMSK2) PCICR &= ~_BV(PCIE2);
+    DIDR1 = _BV(AIN1D);
+
     // enable analog comparator interrupt
     ACSR = _BV(ACBG) | _BV(ACIE) | _BV(ACI);
 
-    system.status &= ~SYSTEM_SLEEP; // clear sleep flag
+    system.status &= ~(SYSTEM_SLEEP | SYSTEM_FAST_CLOCK);  // clear sleep flag
 }
 
 
+// sleep about 64 ms, woken by the watchdog interrupt; the timer2
+// interrupt may wake the system earlier, so sleep until the watchdog
+// interrupt clears WDIE; leaves the watchdog timer stopped
+void system_debounce_sleep(void) {
+    wdt_reset();
+    WDTCSR = _BV(WDCE) | _BV(WDE);    // start timed sequence
+    WDTCSR = _BV(WDIE) | _BV(WDP1);   // interrupt only, 64 ms timeout
+
+    set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+    while(WDTCSR & _BV(WDIE)) {
+	sei();
+	sleep_cpu();
+	cli();
+    }
+}
+
+
+// watchdog interrupt; only enabled while debouncing restored power
+ISR(WDT_vect) {
+    WDTCSR &= ~_BV(WDIE);
+}
+
+
+// set system clock during sleep: 2 MHz while the buzzer sounds or
+// a battery check runs, otherwise the slowest clock that keeps timer2
+// reliable; also called by piezo.c as the buzzer starts and stops
+void system_sleep_clock(void) {
+    if(system.status & (SYSTEM_ALARM_SOUNDING | SYSTEM_FAST_CLOCK)) {
+	clock_prescale_set(SYSTEM_SLEEP_FAST_CLOCK);
+    } else {
+	clock_prescale_set(SYSTEM_SLEEP_CLOCK);
+    }
+}
+
+
+#ifdef TICKLESS_SLEEP
+// returns seconds until system_sleep_loop() must next run
+// (watchdog disable and battery check happen on exact seconds)
+uint8_t system_sleep_due(void) {
+    if(system.sleep_wake_timer < SYSTEM_WDT_DISABLE_DELAY) {
+	uint8_t due = SYSTEM_WDT_DISABLE_DELAY - system.sleep_wake_timer;
+	return due < SYSTEM_WDT_TICKLESS_MAX ? due : SYSTEM_WDT_TICKLESS_MAX;
+    }
+
+    if(system.sleep_wake_timer < system.battery_check
+	    && system.battery_check - system.sleep_wake_timer
+	       < UINT8_MAX) {
+	return system.battery_check - system.sleep_wake_timer;
+    }
+
+    return UINT8_MAX;
+}
+#endif  // TICKLESS_SLEEP
+
+
 // checks the analog comparator and returns current power source
 uint8_t system_power(void) {
     if(ACSR & _BV(ACO)) {
@@ -189,18 +327,18 @@ void system_check_battery(void) {
     power_adc_enable();
 
     // select bandgap as analog to digital input
-    //   REFS1:0 =   00:  VREF pin as voltage reference
+    //   REFS1:0 =   00:  VREF pin as voltage reference (see SYSTEM_ADC_REF)
     //   MUX3:0  = 1110:  1.1v bandgap as input
-    ADMUX = _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+    ADMUX = SYSTEM_ADC_REF | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
 
     // configure analog to digital converter
     // ADEN    =   1:  enable analog to digital converter
-    // ADSC    =   1:  start ADC conversion now
-    // ADPS2:0 = 100:  system clock / 16  (4 MHz / 4 = 125 kHz)
-    ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADPS2);
+    // ADIE    =   1:  interrupt (and wake) when conversion completes
+    // ADPS2:0 = 100:  system clock / 16  (8 MHz / 4 / 16 = 125 kHz)
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2);
 
-    // wait for conversion to complete
-    while(ADCSRA & _BV(ADSC));
+    // discard first conversion
+    system_adc_sleep();
 
     uint16_t adc_curr = 0, adc_prev  = 0;
     int16_t  adc_err  = 0;
@@ -209,9 +347,7 @@ void system_check_battery(void) {
     // the analog-to-digital converter may take a while to converge
     while(adc_good < SYSTEM_BATTERY_GOOD_CONV
 	    && adc_count++ < SYSTEM_BATTERY_MAX_CONV) {
-       ADCSRA |= _BV(ADSC);            // start adc conversion
-       while(ADCSRA & _BV(ADSC));      // wait for result
-       adc_curr = ADC;                 // save current value
+       adc_curr = system_adc_sleep();  // convert and save value
        adc_err = adc_prev - adc_curr;  // calculate error--
                                        // difference from previous value
 
@@ -234,8 +370,147 @@ void system_check_battery(void) {
     if(adc_curr > 1024UL * 1100 / LOW_BATTERY_VOLTAGE) {
        system.status |= SYSTEM_LOW_BATTERY;
     } else {
-       system.status &= ~_BV(SYSTEM_LOW_BATTERY);
+       system.status &= ~SYSTEM_LOW_BATTERY;
     }
+
+#ifdef BATTERY_GAUGE
+    // log voltage and schedule next measurement
+    if(adc_curr) system_gauge_log(1024UL * 1100 / adc_curr);
+    system.battery_check += SYSTEM_GAUGE_INTERVAL;
+#endif  // BATTERY_GAUGE
+}
+
+
+#ifdef BATTERY_GAUGE
+// log battery voltage (in millivolts) with total time on battery power
+void system_gauge_log(uint16_t mv) {
+    system_gauge_t record;
+
+    if(mv < 1000) mv = 1000;
+    if(mv > 3550) mv = 3550;
+
+    record.voltage = (mv - 1000) / 10;
+    record.hours   = (eeprom_read_dword(&ee_system_gauge_seconds)
+		      + system.sleep_wake_timer) / 3600;
+
+    uint8_t idx = eeprom_read_byte(&ee_system_gauge_idx);
+    if(idx >= SYSTEM_GAUGE_HISTORY) idx = 0;
+
+    eeprom_update_block(&record, &ee_system_gauge_history[idx],
+			sizeof(record));
+    eeprom_update_byte(&ee_system_gauge_idx, (idx+1) % SYSTEM_GAUGE_HISTORY);
+
+    uint8_t count = eeprom_read_byte(&ee_system_gauge_count);
+    if(count < SYSTEM_GAUGE_HISTORY) {
+	eeprom_update_byte(&ee_system_gauge_count, count + 1);
+    }
+}
+
+
+// returns most recently logged battery voltage
+// in millivolts or zero if no voltage was logged
+uint16_t system_gauge_voltage(void) {
+    if(!eeprom_read_byte(&ee_system_gauge_count)) return 0;
+
+    uint8_t idx = eeprom_read_byte(&ee_system_gauge_idx);
+    if(!idx || idx > SYSTEM_GAUGE_HISTORY) idx = SYSTEM_GAUGE_HISTORY;
+
+    return 1000 + 10 * eeprom_read_byte(
+	    &ee_system_gauge_history[idx - 1].voltage);
+}
+
+
+// returns estimated remaining battery capacity in percent: the share
+// of rated hours not yet used, limited by the most recent voltage
+uint8_t system_gauge_level(void) {
+    uint32_t hours = eeprom_read_dword(&ee_system_gauge_seconds) / 3600;
+    uint8_t level  = 0;
+
+    if(hours < SYSTEM_GAUGE_RATED_HOURS) {
+	level = 100 - hours * 100 / SYSTEM_GAUGE_RATED_HOURS;
+    }
+
+    uint16_t mv = system_gauge_voltage();
+    if(mv && mv < SYSTEM_GAUGE_FULL_VOLTAGE) {
+	uint8_t mv_level = 0;
+
+	if(mv > LOW_BATTERY_VOLTAGE) {
+	    mv_level = (uint32_t)(mv - LOW_BATTERY_VOLTAGE) * 100
+		       / (SYSTEM_GAUGE_FULL_VOLTAGE - LOW_BATTERY_VOLTAGE);
+	}
+
+	if(mv_level < level) level = mv_level;
+    }
+
+    return level;
+}
+
+
+// returns estimated days of backup remaining
+uint16_t system_gauge_days(void) {
+    return SYSTEM_GAUGE_RATED_HOURS * system_gauge_level() / 2400;
+}
+
+
+// clears battery history after the battery is replaced
+void system_gauge_reset(void) {
+    eeprom_update_dword(&ee_system_gauge_seconds, 0);
+    eeprom_update_byte(&ee_system_gauge_idx,   0);
+    eeprom_update_byte(&ee_system_gauge_count, 0);
+}
+
+
+#if defined(DEBUG) || defined(GPS_TIMEKEEPING)
+// prints battery history, oldest first, and current estimates
+void system_gauge_dump(void) {
+    uint8_t count = eeprom_read_byte(&ee_system_gauge_count);
+    uint8_t idx   = eeprom_read_byte(&ee_system_gauge_idx);
+
+    if(count > SYSTEM_GAUGE_HISTORY) count = SYSTEM_GAUGE_HISTORY;
+    if(idx  >= SYSTEM_GAUGE_HISTORY) idx   = 0;
+
+    idx = (idx + SYSTEM_GAUGE_HISTORY - count) % SYSTEM_GAUGE_HISTORY;
+
+    usart_print_pstr(PSTR("battery hours mv"));
+    usart_print_ln();
+
+    while(count--) {
+	system_gauge_t record;
+	eeprom_read_block(&record, &ee_system_gauge_history[idx],
+			  sizeof(record));
+
+	usart_print_int(record.hours);
+	usart_print_pstr(PSTR(" "));
+	usart_print_int(1000 + 10 * record.voltage);
+	usart_print_ln();
+
+	idx = (idx + 1) % SYSTEM_GAUGE_HISTORY;
+    }
+
+    usart_print_pstr(PSTR("battery level "));
+    usart_print_int(system_gauge_level());
+    usart_print_pstr(PSTR("% days "));
+    usart_print_int(system_gauge_days());
+    usart_print_ln();
+}
+#endif  // DEBUG || GPS_TIMEKEEPING
+#endif  // BATTERY_GAUGE
+
+
+// performs one adc conversion in adc noise reduction mode, so the
+// processor is halted during conversion; returns the conversion result
+uint16_t system_adc_sleep(void) {
+    set_sleep_mode(SLEEP_MODE_ADC);
+
+    // halting the processor starts the conversion; timer2 may wake the
+    // system early, but the conversion continues during the interrupt
+    do {
+	sei();
+	sleep_cpu();
+	cli();
+    } while(ADCSRA & _BV(ADSC));
+
+    return ADC;
 }
 
 
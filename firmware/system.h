@@ -24,6 +24,16 @@
 // (10 minutes) should be a safe choice
 #define SYSTEM_BATTERY_CHECK_DELAY 600  // seconds
 
+// adc reference for battery and photoresistor conversions:  the AREF
+// pin, which is wired to the supply, unless AREF has been disconnected
+// from the supply (see AREF_ISOLATED in config.h), in which case AVCC
+// is selected instead
+#ifdef AREF_ISOLATED
+#define SYSTEM_ADC_REF _BV(REFS0)  // REFS1:0 = 01:  AVCC
+#else
+#define SYSTEM_ADC_REF 0           // REFS1:0 = 00:  AREF
+#endif  // AREF_ISOLATED
+
 // how many consecutive good ADC readings must be read before
 // using the final reading to estimate battery voltage
 #define SYSTEM_BATTERY_GOOD_CONV 3
@@ -39,6 +49,40 @@
 #define SYSTEM_BATTERY_MAX_CONV 16
 
 
+#ifdef BATTERY_GAUGE
+// BATTERY FUEL GAUGE
+//
+// battery voltage is measured at SYSTEM_BATTERY_CHECK_DELAY and every
+// SYSTEM_GAUGE_INTERVAL thereafter, and the most recent measurements
+// are kept in eeprom with total time on battery power
+
+#ifndef BATTERY_CAPACITY
+#define BATTERY_CAPACITY 225  // milliamp hours
+#endif  // ~BATTERY_CAPACITY
+
+#ifndef BATTERY_SLEEP_CURRENT
+#define BATTERY_SLEEP_CURRENT 10  // microamps
+#endif  // ~BATTERY_SLEEP_CURRENT
+
+// expected hours of backup from a new battery
+#define SYSTEM_GAUGE_RATED_HOURS \
+    (BATTERY_CAPACITY * 1000UL / BATTERY_SLEEP_CURRENT)
+
+#define SYSTEM_GAUGE_INTERVAL 21600  // seconds (6 hours)
+#define SYSTEM_GAUGE_HISTORY  16     // measurements kept in eeprom
+
+// a new battery is considered full at or above this voltage;
+// the gauge reads empty at LOW_BATTERY_VOLTAGE
+#define SYSTEM_GAUGE_FULL_VOLTAGE 2900  // millivolts
+
+// battery voltage history record
+typedef struct {
+    uint8_t  voltage;  // 10 mV units above one volt
+    uint16_t hours;    // total hours on battery power when measured
+} system_gauge_t;
+#endif  // BATTERY_GAUGE
+
+
 // CRYSTAL ROBUSTNESS / PREVENTING SLEEP LOCKUPS
 //
 // if the crystal oscillator is not running while the system sleeps the
@@ -46,6 +90,24 @@
 // disabled after the following time delay
 #define SYSTEM_WDT_DISABLE_DELAY 10  // seconds
 
+// longest tickless sleep period while the eight-second watchdog timer
+// is still enabled; the watchdog oscillator is only accurate to tens
+// of percent, so periods are kept to half the timeout
+#define SYSTEM_WDT_TICKLESS_MAX 4  // seconds
+
+
+// SYSTEM CLOCK DURING SLEEP
+//
+// during sleep, the system clock runs as slowly as possible while
+// the buzzer is silent.  timer2 is clocked asynchronously by the
+// 32.768 kHz crystal, so the system clock must remain faster than
+// four times the crystal frequency: 8 MHz / 32 = 250 kHz is the slowest
+// permissible setting.  while the buzzer sounds, during battery checks,
+// and after power is restored, the clock returns to 8 MHz / 4 = 2 MHz,
+// which piezo.c, the adc prescaler, and the wake functions expect
+#define SYSTEM_SLEEP_CLOCK clock_div_32  // 250 kHz
+#define SYSTEM_SLEEP_FAST_CLOCK clock_div_4  // 2 MHz
+
 
 // return codes for the system_power() function
 enum {
@@ -58,12 +120,14 @@ enum {
 #define SYSTEM_SLEEP          0x01
 #define SYSTEM_ALARM_SOUNDING 0x02
 #define SYSTEM_LOW_BATTERY    0x04
+#define SYSTEM_FAST_CLOCK     0x08  // hold 2 MHz clock during sleep
 
 
 typedef struct {
     uint8_t  status;         // system status flags
     uint8_t  initial_mcusr;  // initial value of MCUSR register
     uint32_t sleep_wake_timer;    // amount of time in sleep or wake mode
+    uint32_t battery_check;  // sleep_wake_timer at next battery check
 } system_t;
 
 
@@ -89,10 +153,27 @@ static inline void system_tick(void) {
 
 static inline void system_semitick(void) {};
 
-void system_idle_loop(void);
+void system_idle_loop(void) __attribute__((noreturn));
 void system_sleep_loop(void);
+void system_sleep_clock(void);
 
 uint8_t system_power(void);
 uint8_t system_onbutton(void);
 
+#ifdef TICKLESS_SLEEP
+uint8_t system_sleep_due(void);
+#endif  // TICKLESS_SLEEP
+
+#ifdef BATTERY_GAUGE
+uint16_t system_gauge_voltage(void);
+uint8_t system_gauge_level(void);
+uint16_t system_gauge_days(void);
+void system_gauge_reset(void);
+#if defined(DEBUG) || defined(GPS_TIMEKEEPING)
+void system_gauge_dump(void);
+#else
+static inline void system_gauge_dump(void) {};
+#endif  // DEBUG || GPS_TIMEKEEPING
+#endif  // BATTERY_GAUGE
+
 #endif
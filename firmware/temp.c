@@ -1,6 +1,7 @@
 // temp.c  --  acquires measurements from temperature sensor
 //
 //    PC1        1-Wire bus
+//    ADC8       internal temperature sensor (if TEMPERATURE_INTERNAL)
 //
 
 #include "config.h"
@@ -11,35 +12,50 @@
 #include <util/delay.h>
 #include <util/atomic.h>
 #include <avr/wdt.h>
+#include <avr/eeprom.h>
 
 #include "temp.h"
 #include "time.h"
 #include "usart.h"
 #include "system.h"
 
+#ifndef TEMPERATURE_INTERNAL
 #define TEMP_CMD_SKIPROM     0xCC
+#define TEMP_CMD_MATCHROM    0x55
+#define TEMP_CMD_SEARCHROM   0xF0
 #define TEMP_CMD_CONVERTTEMP 0x44
 #define TEMP_CMD_RSCRATCHPAD 0xBE
+#define TEMP_CMD_WSCRATCHPAD 0x4E
+
+// alarm thresholds written with configuration (alarms are unused)
+#define TEMP_ALARM_HIGH 0x7F
+#define TEMP_ALARM_LOW  0x80
+#endif  // ~TEMPERATURE_INTERNAL
 
 // extern'ed temperature data
 volatile temp_t temp;
 
 
-void temp_start_conv(void);
-void temp_read_conv(void);
-void temp_calc_error(void);
-
-uint8_t temp_reset(void);
+#ifdef XTAL_LEARN_CURVE
+// learned crystal frequency error [2^-30 seconds per second]
+// at TEMP_CURVE_MIN + (idx << TEMP_CURVE_STEP) for each idx
+uint16_t ee_temp_curve[TEMP_CURVE_SIZE] EEMEM = {
+    [0 ... TEMP_CURVE_SIZE - 1] = TEMP_CURVE_UNSET
+};
+#endif  // XTAL_LEARN_CURVE
 
-void temp_write_bit(uint8_t);
-uint8_t temp_read_bit(void);
 
-void temp_write_byte(uint8_t);
-uint8_t temp_read_byte(void);
+void temp_calc_error(void);
 
-void temp_power_bus(void);
+#ifndef TEMPERATURE_INTERNAL
+void temp_start_comm(uint8_t txlen, uint8_t rxlen);
+void temp_address(void);
+void temp_search(void);
+void temp_adapt(int16_t old_temp);
 
-uint8_t temp_read_scratch(void);
+void temp_read_scratch(uint8_t sensor);
+uint8_t temp_crc(const volatile uint8_t *data, uint8_t len);
+#endif  // ~TEMPERATURE_INTERNAL
 
 
 // initialize timekeeping variables
@@ -50,16 +66,65 @@ void temp_init(void) {
     temp.adjust     = 0;
     temp.error      = 0;
     temp.temp       = TEMP_INVALID;  // invalid temperature
+
+#ifdef TEMPERATURE_INTERNAL
+    temp.adc_sum    = 0;
+    temp.adc_count  = 0;
+#else
+    temp.interval   = TEMP_CONV_INTERVAL_MIN;
+    temp.resolution = TEMP_RES_12BIT;
+    temp.sensors    = 0;
+    temp.retries    = 0;
+    temp.ow_state   = TEMP_OW_IDLE;
+
+    // sensors must be found and configured before first conversion
+    temp.status |= TEMP_SEARCH_PENDING;
+    temp.status |= TEMP_CONFIG_PENDING;
+#endif  // TEMPERATURE_INTERNAL
+
+#ifdef XTAL_LEARN_CURVE
+    // lookups use this copy, so they read no eeprom
+    // and compute no parabola
+    for(uint8_t idx = 0; idx < TEMP_CURVE_SIZE; ++idx) {
+	temp.curve[idx] = temp_curve_entry(idx);
+    }
+
+    temp.curve_dirty = TEMP_LEARN_NONE;
+    temp.learn_idx   = TEMP_LEARN_NONE;
+#endif  // XTAL_LEARN_CURVE
 }
 
 
 void temp_sleep(void) {
+#ifdef XTAL_LEARN_CURVE
+    // gps is unavailable during sleep
+    temp_learn_reset();
+#endif  // XTAL_LEARN_CURVE
+
+#ifdef TEMPERATURE_INTERNAL
+    // discard samples; adc is disabled during sleep
+    temp.adc_sum   = 0;
+    temp.adc_count = 0;
+#else
+    // abandon communication in progress
+    temp.ow_state = TEMP_OW_IDLE;
+
     // disable output on the one-wire bus
     DDRC  &= ~_BV(PC1);  // set as input
     PORTC &= ~_BV(PC1);  // disable pull-up
 
-    // mark current conversion as invalid
-    temp.status |= TEMP_CONV_INVALID;
+    // mark current conversion as invalid; sensors lose their
+    // scratchpads, so a pending read is not retried
+    temp.status |=  TEMP_CONV_INVALID;
+    temp.status &= ~TEMP_READ_PENDING;
+    temp.retries = 0;
+
+    // sensors lose power and configuration during sleep
+    // and might be exchanged before wake
+    temp.status |=  TEMP_CONFIG_PENDING;
+    temp.status |=  TEMP_SEARCH_PENDING;
+    temp.status &= ~TEMP_SEARCH_PASS;
+#endif  // TEMPERATURE_INTERNAL
 }
 
 
@@ -69,287 +134,709 @@ void temp_tick(void) {
 	++temp.int_timer;
     }
 
-    // sample temperature if awake
-    if(!(system.status & SYSTEM_SLEEP)) {
+#ifdef XTAL_LEARN_CURVE
+    if(temp.learn_timer < UINT16_MAX) ++temp.learn_timer;
+
+    // save a learned curve entry here rather than in temp_learn(),
+    // which runs within the usart interrupt with interrupts disabled
+    uint8_t idx;
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	idx = temp.curve_dirty;
+	temp.curve_dirty = TEMP_LEARN_NONE;
+    }
+    if(idx != TEMP_LEARN_NONE) {
+	eeprom_write_word(&ee_temp_curve[idx], temp.curve[idx]);
+    }
+#endif  // XTAL_LEARN_CURVE
+
+#ifdef TEMPERATURE_INTERNAL
+    if(system.status & SYSTEM_SLEEP) return;
+
+    // wait for next reading
+    if(temp.conv_timer && --temp.conv_timer) return;
+    temp.conv_timer = TEMP_INTERNAL_INTERVAL;
+
+    uint32_t sum;
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	sum   = temp.adc_sum;
+	count = temp.adc_count;
+	temp.adc_sum   = 0;
+	temp.adc_count = 0;
+    }
+
+    if(!count) return;
+
+    // average adc result times 64, then sensor voltage times 16,
+    // against the internal 1.1 volt reference:
+    //   mV * 16 = (adc * 64) * 1100 * 16 / (1024 * 64)
+    uint16_t adc = (sum << 6) / count;
+    int16_t  mv  = ((uint32_t)adc * 275) >> 10;
 
-	// prevent interruption if communication already in progress
-	cli();
-	if(temp.status & TEMP_COMM_LOCK) {
-	    sei();
+    // sensor voltage increases by about 1 mV per deg C
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	temp.temp = mv - (TEMPERATURE_INTERNAL_OFFSET << 4);
+	temp_calc_error();
+	temp.int_timer = 0;
+    }
+
+    DUMPINT(temp_degC());
+#else
+    // sample temperature only if awake and sensor not busy
+    if((system.status & SYSTEM_SLEEP) || temp.ow_state) return;
+
+    // search bus for sensors as required
+    if(temp.status & TEMP_SEARCH_PENDING) {
+	temp_search();
+	return;
+    }
+
+    // process scratchpads after reads complete
+    if(temp.status & TEMP_READ_PENDING) {
+	uint8_t failed = temp.status & TEMP_CONV_INVALID;
+
+	for(uint8_t i = 0; i < temp.sensors; ++i) {
+	    if(temp.status & TEMP_CONV_INVALID) {
+		temp.temps[i] = TEMP_INVALID;
+	    } else {
+		temp_read_scratch(i);
+		if(temp.temps[i] == TEMP_INVALID) failed = 1;
+	    }
+
+	    DUMPINT(temp.temps[i]);
+	}
+
+	// read again on failure; scratchpads keep the conversion
+	if(failed && temp.retries < TEMP_READ_RETRIES) {
+	    ++temp.retries;
+	    temp.status &= ~TEMP_CONV_INVALID;
+	    temp.ow_sensor = 0;
+	    temp_address();
 	    return;
-	} else {
-	    temp.status |= TEMP_COMM_LOCK;
-	    sei();
 	}
 
-	// check previous temperature conversion as required
-	if((temp.status & TEMP_CONV_STARTED) && !--temp.conv_timer) {
-	    temp_read_conv();
+	temp.retries = 0;
+
+	if(XTAL_SENSOR < temp.sensors
+		&& temp.temps[XTAL_SENSOR] != TEMP_INVALID) {
+	    int16_t old_temp = temp.temp;
+
 	    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-		if(!(temp.status & TEMP_CONV_INVALID)) {
-		    temp_calc_error();
-		    temp.int_timer = 0;
-		}
-		temp.status &= ~TEMP_CONV_STARTED;
-		temp.status &= ~TEMP_CONV_INVALID;
+		temp.temp = temp.temps[XTAL_SENSOR];
+		temp_calc_error();
+		temp.int_timer = 0;
 	    }
-	}
 
-	// start new temperature conversion as required
-	if(!(temp.status & TEMP_CONV_STARTED)
-		|| (temp.status & TEMP_CONV_INVALID)) {
-	    temp.status |=  TEMP_CONV_STARTED;
-	    temp.status &= ~TEMP_CONV_INVALID;
-	    temp.conv_timer = TEMP_CONV_INTERVAL;
-	    temp_start_conv();
+	    temp_adapt(old_temp);
 	}
+
+	temp.status &= ~TEMP_READ_PENDING;
+	temp.status &= ~TEMP_CONV_STARTED;
+	temp.status &= ~TEMP_CONV_INVALID;
     }
 
-    // release sensor communication lock
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	temp.status &= ~TEMP_COMM_LOCK;
+    // read every sensor one second after starting conversion
+    // (conversion takes at most 750 ms)
+    if((temp.status & TEMP_CONV_STARTED)
+	    && !(temp.status & TEMP_CONV_INVALID)) {
+	temp.status |= TEMP_READ_PENDING;
+	temp.ow_sensor = 0;
+	temp_address();
+	return;
     }
+
+    // wait for next conversion, unless last conversion failed
+    if(!(temp.status & TEMP_CONV_STARTED)
+	    && temp.conv_timer && --temp.conv_timer) {
+	return;
+    }
+
+    // search again if no sensors were found
+    if(!temp.sensors) {
+	temp.status |= TEMP_SEARCH_PENDING;
+	return;
+    }
+
+    // write sensor resolution to all sensors as required
+    if(temp.status & TEMP_CONFIG_PENDING) {
+	temp.status &= ~TEMP_CONFIG_PENDING;
+	temp.ow_tx[0] = TEMP_CMD_SKIPROM;
+	temp.ow_tx[1] = TEMP_CMD_WSCRATCHPAD;
+	temp.ow_tx[2] = TEMP_ALARM_HIGH;
+	temp.ow_tx[3] = TEMP_ALARM_LOW;
+	temp.ow_tx[4] = temp.resolution;
+	temp_start_comm(5, 0);
+	return;
+    }
+
+    // start new temperature conversion on all sensors
+    temp.status |=  TEMP_CONV_STARTED;
+    temp.status &= ~TEMP_CONV_INVALID;
+    temp.conv_timer = temp.interval - 1;  // less one second to read
+    temp.ow_tx[0] = TEMP_CMD_SKIPROM;
+    temp.ow_tx[1] = TEMP_CMD_CONVERTTEMP;
+    temp_start_comm(2, 0);
+#endif  // TEMPERATURE_INTERNAL
 }
 
 
-// starts a new temperature conversion
-void temp_start_conv(void) {
-    if(temp_reset()) {
-	temp_write_byte(TEMP_CMD_SKIPROM);
-	temp_write_byte(TEMP_CMD_CONVERTTEMP);
-	temp_power_bus();
-    } else {
-	temp.status |= TEMP_CONV_INVALID;
+#ifndef TEMPERATURE_INTERNAL
+
+// starts a 1-wire transaction in the background:  reset, transmit
+// ow_tx[0 ... txlen - 1], and then receive rxlen bytes
+void temp_start_comm(uint8_t txlen, uint8_t rxlen) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // also called from interrupt
+	temp.ow_txlen = txlen;
+	temp.ow_rxlen = rxlen;
+	temp.ow_timer = 0;
+	temp.ow_state = TEMP_OW_RESET;
     }
 }
 
 
-// reads result of temperature conversion from scratchpad
-void temp_read_conv(void) {
-    if(temp_reset()) {
-	temp_write_byte(TEMP_CMD_SKIPROM);
-	temp_write_byte(TEMP_CMD_RSCRATCHPAD);
-	if(!temp_read_scratch()) {
-	    temp.status |= TEMP_CONV_INVALID;
-	} else {
-	    DUMPINT(temp_degC());
-	    DUMPINT(temp_degF());
+// starts scratchpad read from sensor temp.ow_sensor; also
+// called from temp_onewire() to read each sensor in turn
+void temp_address(void) {
+    temp.ow_tx[0] = TEMP_CMD_MATCHROM;
+
+    for(uint8_t i = 0; i < TEMP_ROM_SIZE; ++i) {
+	temp.ow_tx[i + 1] = temp.rom[temp.ow_sensor][i];
+    }
+
+    temp.ow_tx[TEMP_ROM_SIZE + 1] = TEMP_CMD_RSCRATCHPAD;
+    temp_start_comm(TEMP_ROM_SIZE + 2, TEMP_SCRATCH_SIZE);
+}
+
+
+// searches the bus for sensors, one sensor per call:  completes the
+// previous search pass, if any, and starts the next pass
+void temp_search(void) {
+    if(temp.status & TEMP_SEARCH_PASS) {
+	volatile uint8_t *rom = temp.rom[temp.sensors];
+
+	temp.status &= ~TEMP_SEARCH_PASS;
+
+	if((temp.status & TEMP_CONV_INVALID)
+		|| temp_crc(rom, TEMP_ROM_SIZE - 1) != rom[TEMP_ROM_SIZE - 1]) {
+	    // abandon search on error
+	    temp.search_last = 0;
+	} else if(rom[0] == TEMP_FAMILY_DS18B20) {
+	    // keep sensor; next pass follows its rom code
+	    if(++temp.sensors < TEMP_SENSOR_MAX) {
+		for(uint8_t i = 0; i < TEMP_ROM_SIZE; ++i) {
+		    temp.rom[temp.sensors][i] = rom[i];
+		}
+	    }
+	}  // else ignore other devices
+
+	// finish when no discrepancies remain
+	if(!temp.search_last || temp.sensors == TEMP_SENSOR_MAX) {
+	    temp.status &= ~TEMP_SEARCH_PENDING;
+
+	    if(temp.sensors) {
+		temp.status &= ~TEMP_CONV_INVALID;
+	    } else {
+		temp.status |=  TEMP_CONV_INVALID;
+	    }
+
+	    DUMPINT(temp.sensors);
+	    return;
 	}
     } else {
-	temp.status |= TEMP_CONV_INVALID;
+	// start new search
+	temp.sensors     = 0;
+	temp.search_last = 0;
+    }
+
+    temp.status |= TEMP_SEARCH_PASS;
+    temp.status &= ~TEMP_CONV_INVALID;
+    temp.ow_tx[0] = TEMP_CMD_SEARCHROM;
+    temp_start_comm(1, 0);
+}
+
+
+// adapts conversion interval and resolution to the rate of
+// temperature change; old_temp is the previous temperature
+void temp_adapt(int16_t old_temp) {
+    int16_t change = temp.temp - old_temp;
+    if(change < 0) change = -change;
+
+    if(old_temp == TEMP_INVALID || change >= TEMP_CHANGE_FAST) {
+	// temperature changing quickly: sample often
+	temp.interval = TEMP_CONV_INTERVAL_MIN;
+    } else if(change > TEMP_CHANGE_SLOW) {
+	if(temp.interval > TEMP_CONV_INTERVAL_MIN) temp.interval >>= 1;
+    } else {
+	if(temp.interval < TEMP_CONV_INTERVAL_MAX) temp.interval <<= 1;
+    }
+
+    // fast sampling uses high resolution; slow sampling, low
+    uint8_t resolution = (temp.interval < TEMP_HIRES_INTERVAL
+			  ? TEMP_RES_12BIT : TEMP_RES_10BIT);
+
+    if(resolution != temp.resolution) {
+	temp.resolution = resolution;
+	temp.status |= TEMP_CONFIG_PENDING;
     }
 }
+#endif  // ~TEMPERATURE_INTERNAL
 
 
 // calculate timekeeping error using last known temperature
 // (temp.temp) and time interval (temp.int_timer)
 void temp_calc_error(void) {
-    int32_t error;
-    if(temp.int_timer < 300) {
-	// use accurate method for small time intervals
-	// to minimize rounding error
-	error  = XTAL_TURNOVER_TEMP - temp.temp;
-	error *= error;
-	error *= XTAL_FREQUENCY_COEF;
-        error *= temp.int_timer;
-	temp.error += error;
+    // time error per second [2^-36 of 1/128 seconds]
+#ifdef XTAL_LEARN_CURVE
+    uint32_t rate  = (uint32_t)temp_curve(temp.temp) << 13;
+#else
+    // far from the turnover temperature, the rate saturates
+    // rather than overflowing 32 bits
+    int16_t  delta  = XTAL_TURNOVER_TEMP - temp.temp;
+    uint32_t square = (int32_t)delta * delta;
+    uint32_t rate   = (square <= UINT32_MAX / TEMP_ERROR_COEF
+		       ? square * TEMP_ERROR_COEF : UINT32_MAX);
+#endif  // XTAL_LEARN_CURVE
+
+    // multiply rate by time interval; the 64-bit product
+    // is computed from 16-bit halves to avoid 64-bit arithmetic
+    uint32_t interval = temp.int_timer;
+    uint32_t ll  = (rate & 0xFFFF) * (interval & 0xFFFF);
+    uint32_t lh  = (rate & 0xFFFF) * (interval >> 16);
+    uint32_t hl  = (rate >> 16)    * (interval & 0xFFFF);
+    uint32_t hh  = (rate >> 16)    * (interval >> 16);
+    uint32_t mid = (ll >> 16) + (lh & 0xFFFF) + (hl & 0xFFFF);
+    uint32_t lo  = (mid << 16) | (ll & 0xFFFF);
+    uint32_t hi  = hh + (lh >> 16) + (hl >> 16) + (mid >> 16);
+
+    // top 28 bits are 1/128 seconds; bottom 36 bits are fractions
+    // thereof, of which the most significant 32 bits are kept
+    uint32_t frac  = (hi << 28) | (lo >> 4);
+    uint32_t ticks = hi >> 4;
+
+    // accumulate fractional 1/128 seconds with carry
+    temp.error += frac;
+    if(temp.error < frac) ++ticks;
+
+    // time_autodrift() applies 1/128 second adjustments, but whole
+    // seconds are added to the time immediately, in one step
+    ticks += temp.adjust;
+    temp.adjust = ticks & 0x7F;
+    if(ticks >> 7) time_addseconds(ticks >> 7);
+}
+
+
+#ifdef XTAL_LEARN_CURVE
+// returns crystal frequency error at temperature t (deg C / 16)
+// interpolated from learned curve [2^-30 seconds per second]
+uint16_t temp_curve(int16_t t) {
+    if(t < TEMP_CURVE_MIN) t = TEMP_CURVE_MIN;
+    if(t > TEMP_CURVE_MAX) t = TEMP_CURVE_MAX;
+
+    uint16_t pos  = t - TEMP_CURVE_MIN;
+    uint8_t  idx  = pos >> TEMP_CURVE_STEP;
+    uint8_t  frac = pos & (_BV(TEMP_CURVE_STEP) - 1);
+
+    uint16_t low = temp.curve[idx];
+    if(!frac) return low;
+
+    // linear interpolation between adjacent entries, rounded down;
+    // the unsigned difference times the fraction is a widening 16-bit
+    // multiply, where a signed 32-bit slope would need a 32-bit one
+    uint16_t high = temp.curve[idx + 1];
+    if(high >= low) {
+	return low + (((uint32_t)(uint16_t)(high - low) * frac)
+		      >> TEMP_CURVE_STEP);
     } else {
-	// use less accurate method for large time intervals
-	// to prevent overflow (when the clock has been
-	// sleeping for more than about five minutes)
-	error  = (XTAL_TURNOVER_TEMP - (temp.temp + 0x08)) >> 4;
-	error *= error;
-	error *= XTAL_FREQUENCY_COEF;
-        error *= temp.int_timer;
-	while(error > (1000000000UL >> 7)) {
-	    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-		if(temp.adjust == 127) {
-		    temp.adjust = 0;
-		    time_tick();
-		} else {
-		    ++temp.adjust;
-		}
-	    }
-	    error -= (1000000000UL >> 7);
-	}
-	temp.error += (error << 8);
+	return high + (((uint32_t)(uint16_t)(low - high)
+			* (_BV(TEMP_CURVE_STEP) - frac)) >> TEMP_CURVE_STEP);
     }
+}
 
-    while(temp.error > (1000000000UL << 1)) {
-	ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	    ++temp.adjust;
-	}
-	temp.error -= (1000000000UL << 1);
+
+// returns learned curve entry from eeprom or, if not yet
+// learned, the value from the configured parabola
+uint16_t temp_curve_entry(uint8_t idx) {
+    uint16_t entry = eeprom_read_word(&ee_temp_curve[idx]);
+
+    if(entry == TEMP_CURVE_UNSET) {
+	int16_t delta = XTAL_TURNOVER_TEMP - TEMP_CURVE_MIN
+			- ((int16_t)idx << TEMP_CURVE_STEP);
+	uint32_t rate = (uint32_t)((int32_t)delta * delta) * TEMP_ERROR_COEF;
+	rate >>= 13;
+	entry = (rate < TEMP_CURVE_UNSET ? rate : TEMP_CURVE_UNSET - 1);
     }
+
+    return entry;
 }
 
 
-// returns current temperature in degrees celsius
+// refines the curve entry nearest the current temperature from
+// the difference between clock and gps time; offset is clock time
+// minus gps time in 1/128 seconds, ignoring the unknown gps delay
+void temp_learn(int32_t offset) {
+    // temperature must be known and time must not be slewing
+    if(temp.temp == TEMP_INVALID || time.slew_adjust) {
+	temp_learn_reset();
+	return;
+    }
+
+    int16_t t = temp.temp;
+    if(t < TEMP_CURVE_MIN) t = TEMP_CURVE_MIN;
+    if(t > TEMP_CURVE_MAX) t = TEMP_CURVE_MAX;
+    uint8_t idx = (t - TEMP_CURVE_MIN + _BV(TEMP_CURVE_STEP - 1))
+		  >> TEMP_CURVE_STEP;
+
+    // start new comparison if temperature has changed
+    if(idx != temp.learn_idx) {
+	temp.learn_idx    = idx;
+	temp.learn_timer  = 0;
+	temp.learn_offset = offset;
+	return;
+    }
+
+    if(temp.learn_timer < TEMP_LEARN_TIME) return;
+
+    // time lost since comparison started, despite compensation
+    int32_t lost = temp.learn_offset - offset;
+
+    if(-TEMP_LEARN_MAX < lost && lost < TEMP_LEARN_MAX) {
+	// remaining frequency error [2^-30 seconds per second];
+	// only half is applied to average out gps timing jitter
+	int32_t resid = (lost << 23) / temp.learn_timer;
+	int32_t entry = temp.curve[idx] + (resid >> 1);
+
+	if(entry < 0) entry = 0;
+	if(entry >= TEMP_CURVE_UNSET) entry = TEMP_CURVE_UNSET - 1;
+
+	// temp_tick() saves the entry to eeprom
+	temp.curve[idx]  = entry;
+	temp.curve_dirty = idx;
+    }
+
+    // start next comparison
+    temp.learn_timer  = 0;
+    temp.learn_offset = offset;
+}
+
+
+// abandons comparison of clock and gps time, for example,
+// when the clock time is set
+void temp_learn_reset(void) {
+    temp.learn_idx = TEMP_LEARN_NONE;
+}
+#endif  // XTAL_LEARN_CURVE
+
+
+// returns temperature for display:  the first sensor not at
+// the crystal, if any, or otherwise the crystal sensor
+int16_t temp_ambient(void) {
+#ifndef TEMPERATURE_INTERNAL
+    for(uint8_t i = 0; i < temp.sensors; ++i) {
+	if(i != XTAL_SENSOR) return temp.temps[i];
+    }
+#endif  // ~TEMPERATURE_INTERNAL
+
+    return temp.temp;
+}
+
+
+// returns display temperature in degrees celsius
 int16_t temp_degC(void) {
-    int16_t degC = temp.temp;
+    int16_t degC = temp_ambient();
     degC += 0x08;
     degC >>= 4;
     return degC;
 }
 
 
-// returns current temperature in degrees Farenheit
+// returns display temperature in degrees Farenheit
 int16_t temp_degF(void) {
-    int16_t degF = temp.temp / 5 * 9 + 512;
+    int16_t degF = temp_ambient() / 5 * 9 + 512;
     degF += 0x08;
     degF >>= 4;
     return degF;
 }
 
 
-// resets the 1-Wire bus
-// returns true if successful; false otherwise
-uint8_t temp_reset(void) {
-    uint8_t response = 0;
-
-    // pull low for at least 500 us
-    PORTC &= ~_BV(PC1);  // pull low
-    DDRC  |=  _BV(PC1);  // set as output
-    _delay_us(500);
+#ifndef TEMPERATURE_INTERNAL
+// starts a write timeslot for the given bit
+static inline void temp_write_slot(uint8_t bit) {
+    PORTC &= ~_BV(PC1);  // disable pull-up
+    DDRC  |=  _BV(PC1);  // pull low
 
-    // release bus and check device response (timing critical)
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	DDRC &= ~_BV(PC1);  // set as input
-	_delay_us(80);      // wait for response
-	if(PINC & _BV(PC1)) response = 1;  // query bus
-	temp.missed_ovf += 2;
+    if(bit) {  // sending 1
+	_delay_us(2);
+	PORTC |= _BV(PC1);  // pull high
     }
 
-    // additional 420 us delay, so bus released for at least 500 us
-    _delay_us(420);
-
-    // return true if reset successful
-    // (response is low/false if successful)
-    return !response;
+    temp.ow_start = TCNT0;
+    temp.ow_timer = 2;   // 64 us timeslot
 }
 
 
-// writes a bit to the 1-Wire bus:
-// if bit is true, writes 1; if false, writes 0
-void temp_write_bit(uint8_t bit) {
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	PORTC &= ~_BV(PC1);  // disable pull-up
-	DDRC  |=  _BV(PC1);  // pull low
-	_delay_us(10);
-
-	if(bit) {  // sending 1
-	    PORTC |= _BV(PC1);  // pull high
-	    _delay_us(55);      // for 55 us
-	} else {  // sending 0
-	    _delay_us(55);  // remain low for 55 us
-	    PORTC |= _BV(PC1);  // pull high
-	}
+// performs a read timeslot and returns the bit read
+static inline uint8_t temp_read_slot(void) {
+    PORTC &= ~_BV(PC1);  // disable pull-up
+    DDRC  |=  _BV(PC1);  // pull low
+    temp.ow_start = TCNT0;
+    _delay_us(2);
 
-	_delay_us(5);  // 5 us recovery time
-	temp.missed_ovf += 2;
-    }
+    // wait for and read response
+    DDRC &= ~_BV(PC1);   // set to input
+    _delay_us(10);       // wait for response
+
+    temp.ow_timer = 2;   // 64 us timeslot
+    return (PINC & _BV(PC1) ? 1 : 0);
 }
 
 
-// requests a bit from the 1-Wire bus;
-// returns the bit (1 or 0)
-uint8_t temp_read_bit(void) {
-    uint8_t bit = 0;
+// waits until timer0 reaches its count at the start of the timed
+// period, so the period lasts at least its nominal length; stops
+// early if timer0 overflows, as the start count was then passed
+static inline void temp_align(void) {
+    while(TCNT0 < temp.ow_start && !(TIFR0 & _BV(TOV0)));
+}
 
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	// initiate read timeslot
-	PORTC &= ~_BV(PC1);      // disable pull-up
-	DDRC  |=  _BV(PC1);      // pull low
-	_delay_us(3);
-
-	// wait for and read response
-	DDRC &= ~_BV(PC1);       // set to input
-	_delay_us(10);           // wait for response
-	if(PINC & _BV(PC1)) bit = 1;  // query bus
-    }
 
-    // 50 us to complete 60 us timeslot
-    _delay_us(47);
+// abandons the current transaction after a late timer0 overflow;
+// the bus is pulled high to keep sensors powered
+static inline void temp_abort(void) {
+    PORTC |= _BV(PC1);   // enable pull-up
+    DDRC  |= _BV(PC1);   // pull high
+    temp.status |= TEMP_CONV_INVALID;
+    temp.ow_state = TEMP_OW_IDLE;
+}
 
-    // pull bus high for 5 us recovery time
-    PORTC |=  _BV(PC1);      // enable pull-up
-    DDRC  |=  _BV(PC1);      // pull low
-    _delay_us(5);
 
-    return bit;
+// ends a read or write timeslot
+static inline void temp_end_slot(void) {
+    temp_align();        // hold write zero for at least 64 us
+    PORTC |= _BV(PC1);   // enable pull-up
+    DDRC  |= _BV(PC1);   // pull high
+    temp.ow_timer = 1;   // 32 us recovery time
 }
 
 
-// writes a byte to the 1-Wire bus
-void temp_write_byte(uint8_t byte) {
-    for(uint8_t i = 0; i < 8; ++i, byte >>= 1) {
-	temp_write_bit(byte & 0x01);
-	if(temp.status & TEMP_CONV_INVALID) return;
+// advances the current 1-wire transaction; called every
+// timer0 overflow (32 us), so timeslots are multiples of 32 us
+// (see 1-WIRE TIMING in temp.h for interrupt latency)
+void temp_onewire(void) {
+    // give up if this overflow was handled too late
+    if(TIFR0 & _BV(TOV0)) {
+	temp_abort();
+	return;
     }
-}
 
+    // wait for current state to finish
+    if(temp.ow_timer && --temp.ow_timer) return;
+
+    switch(temp.ow_state) {
+	case TEMP_OW_RESET:
+	    // pull low for at least 480 us
+	    PORTC &= ~_BV(PC1);  // pull low
+	    DDRC  |=  _BV(PC1);  // set as output
+	    temp.ow_start = TCNT0;
+	    temp.ow_timer = 17;  // 544 us
+	    temp.ow_state = TEMP_OW_PRESENCE;
+	    break;
+
+	case TEMP_OW_PRESENCE:
+	    // release bus and wait for device response
+	    temp_align();
+	    DDRC &= ~_BV(PC1);   // set as input
+	    temp.ow_start = TCNT0;
+	    temp.ow_timer = 2;   // 64 us
+	    temp.ow_state = TEMP_OW_RECOVER;
+	    break;
+
+	case TEMP_OW_RECOVER:
+	    // device pulls bus low if present; sample no later than
+	    // 75 us after release, when a presence pulse may end
+	    temp_align();
+	    if((uint8_t)(TCNT0 - temp.ow_start) > TEMP_OW_SAMPLE_LATE
+		    || (PINC & _BV(PC1))) {
+		temp_abort();
+		break;
+	    }
 
-// reads a byte from the 1-Wire bus
-uint8_t temp_read_byte(void) {
-    uint8_t byte = 0;
-
-    for(uint8_t bit = 0x01; bit; bit <<= 1) {
-	if(temp_read_bit()) byte |= bit;
-	if(temp.status & TEMP_CONV_INVALID) return 0;
-    }
+	    // wait so bus is released for at least 480 us
+	    temp.ow_timer = 15;  // 480 us
+	    temp.ow_state = TEMP_OW_WRITE;
+	    temp.ow_idx   = 1;
+	    temp.ow_byte  = temp.ow_tx[0];  // rom command
+	    temp.ow_bit   = 0x01;
+	    break;
+
+	case TEMP_OW_WRITE:
+	    temp_write_slot(temp.ow_byte & temp.ow_bit);
+	    temp.ow_state = TEMP_OW_WRITE_END;
+	    break;
+
+	case TEMP_OW_WRITE_END:
+	    temp_end_slot();
+
+	    temp.ow_bit <<= 1;
+	    if(temp.ow_bit) {
+		temp.ow_state = TEMP_OW_WRITE;
+	    } else if(temp.ow_idx < temp.ow_txlen) {
+		// send next byte
+		temp.ow_state = TEMP_OW_WRITE;
+		temp.ow_byte  = temp.ow_tx[temp.ow_idx++];
+		temp.ow_bit   = 0x01;
+	    } else if(temp.ow_rxlen) {
+		temp.ow_state = TEMP_OW_READ;
+		temp.ow_idx   = 0;
+		temp.ow_byte  = 0;
+		temp.ow_bit   = 0x01;
+	    } else if(temp.status & TEMP_SEARCH_PASS) {
+		temp.ow_state = TEMP_OW_SEARCH;
+		temp.ow_idx   = 0;  // rom bit position
+		temp.ow_bit   = 0;  // search timeslot (0, 1, or 2)
+		temp.ow_zero  = 0;
+	    } else {
+		// bus remains pulled high to power the sensors
+		// during conversion (sensors wired in parasitic mode)
+		temp.ow_state = TEMP_OW_IDLE;
+	    }
+	    break;
 
-    return byte;
-}
+	case TEMP_OW_READ:
+	    if(temp_read_slot()) temp.ow_byte |= temp.ow_bit;
+	    temp.ow_state = TEMP_OW_READ_END;
+	    break;
 
+	case TEMP_OW_READ_END:
+	    temp_end_slot();
 
-// sends power via the bus (sensor wired in parasitic mode)
-void temp_power_bus(void) {
-    PORTC |= _BV(PC1);  // enable pull-up
-    DDRC  |= _BV(PC1);  // push high
-}
+	    temp.ow_bit <<= 1;
+	    if(!temp.ow_bit) {
+		temp.scratch[temp.ow_sensor][temp.ow_idx++] = temp.ow_byte;
+		temp.ow_byte = 0;
+		temp.ow_bit  = 0x01;
+	    }
 
+	    if(temp.ow_idx < temp.ow_rxlen) {
+		temp.ow_state = TEMP_OW_READ;
+	    } else if((temp.status & TEMP_READ_PENDING)
+		    && ++temp.ow_sensor < temp.sensors) {
+		// read next sensor without waiting for next tick
+		temp_address();
+	    } else {
+		temp.ow_state = TEMP_OW_IDLE;
+	    }
+	    break;
+
+	case TEMP_OW_SEARCH: {
+	    // each rom bit takes three timeslots:  read bit,
+	    // read complement, and write chosen bit
+	    volatile uint8_t *byte = &temp.rom[temp.sensors][temp.ow_idx >> 3];
+	    uint8_t mask = _BV(temp.ow_idx & 0x07);
+	    uint8_t pos  = temp.ow_idx + 1;
+
+	    if(temp.ow_bit == 0) {
+		temp.ow_byte = temp_read_slot();
+	    } else if(temp.ow_bit == 1) {
+		uint8_t cmp = temp_read_slot();
+
+		if(temp.ow_byte && cmp) {
+		    // no devices responded
+		    temp.status |= TEMP_CONV_INVALID;
+		    temp.ow_state = TEMP_OW_IDLE;
+		    break;
+		}
 
-// reads the entire scratchpad
-uint8_t temp_read_scratch(void) {
-    uint8_t calculated_crc = 0;
-    int16_t new_temp  = 0;
+		if(temp.ow_byte == cmp) {
+		    // devices disagree:  follow previous rom code before
+		    // last discrepancy, choose one at last discrepancy,
+		    // and choose zero after last discrepancy
+		    if(pos < temp.search_last) {
+			temp.ow_byte = (*byte & mask ? 1 : 0);
+		    } else {
+			temp.ow_byte = (pos == temp.search_last);
+		    }
+
+		    if(!temp.ow_byte) temp.ow_zero = pos;
+		}
 
-    for(uint8_t i = 0; i < 8; ++i) {
-	uint8_t byte = temp_read_byte();
-	if(temp.status & TEMP_CONV_INVALID) return 0;
+		if(temp.ow_byte) {
+		    *byte |=  mask;
+		} else {
+		    *byte &= ~mask;
+		}
+	    } else {
+		temp_write_slot(temp.ow_byte);
+	    }
 
-	switch(i) {
-	    case 0:  // temperature lsb
-		new_temp |= byte;
-		break;
-	    case 1:  // temperature msb
-		new_temp |= ((uint16_t)byte << 8);
-		break;
-	    default:
-		break;
+	    temp.ow_state = TEMP_OW_SEARCH_END;
+	    break;
 	}
 
-	// update crc with newly ready byte
+	case TEMP_OW_SEARCH_END:
+	    temp_end_slot();
+
+	    if(++temp.ow_bit > 2) {
+		temp.ow_bit = 0;
+
+		if(++temp.ow_idx == TEMP_ROM_SIZE * 8) {
+		    temp.search_last = temp.ow_zero;
+		    temp.ow_state = TEMP_OW_IDLE;
+		    break;
+		}
+	    }
+
+	    temp.ow_state = TEMP_OW_SEARCH;
+	    break;
+
+	default:
+	    temp.ow_state = TEMP_OW_IDLE;
+	    break;
+    }
+}
+
+
+// returns the 1-wire crc of len bytes of data
+uint8_t temp_crc(const volatile uint8_t *data, uint8_t len) {
+    uint8_t crc = 0;
+
+    for(uint8_t i = 0; i < len; ++i) {
+	uint8_t byte = data[i];
+
+	// update crc with next byte
 	for(uint8_t j = 0; j < 8; ++j, byte >>= 1) {
-	    byte ^= calculated_crc & 0x01;
-	    calculated_crc >>= 1;
-	    if(byte & 0x01) calculated_crc ^= 0x8C;
+	    byte ^= crc & 0x01;
+	    crc >>= 1;
+	    if(byte & 0x01) crc ^= 0x8C;
 	}
     }
 
-    uint8_t reported_crc = temp_read_byte();
+    return crc;
+}
+
 
-    if(!(temp.status & TEMP_CONV_INVALID)
-	    && calculated_crc == reported_crc) {
+// checks the scratchpad crc and extracts the temperature of
+// the given sensor, which is left invalid on failure
+void temp_read_scratch(uint8_t sensor) {
+    volatile uint8_t *scratch = temp.scratch[sensor];
 
-	ATOMIC_BLOCK(ATOMIC_FORCEON) {
-	    temp.temp = new_temp;
-	}
+    if(temp_crc(scratch, TEMP_SCRATCH_SIZE - 1)
+	    == scratch[TEMP_SCRATCH_SIZE - 1]) {
+	uint8_t config = scratch[TEMP_SCRATCH_CONFIG];
+
+	// temperature lsb and msb
+	int16_t new_temp = ((uint16_t)scratch[1] << 8) | scratch[0];
+
+	// clear undefined low bits for resolutions under 12 bits
+	new_temp &= ~(_BV(3 - ((config >> 5) & 0x03)) - 1);
+
+	temp.temps[sensor] = new_temp;
 
-	return 1;
+	// rewrite configuration if sensor lost it
+	if(config != temp.resolution) temp.status |= TEMP_CONFIG_PENDING;
     } else {
-	return 0;
+	temp.temps[sensor] = TEMP_INVALID;
     }
 }
+#endif  // ~TEMPERATURE_INTERNAL
 
 #endif  // TEMPERATURE_SENSOR
@@ -5,26 +5,200 @@
 
 #ifdef TEMPERATURE_SENSOR
 
-#include <stdint.h>  // for INT16_MAX macro
+#include <stdint.h>       // for INT16_MAX macro
+#include <util/atomic.h>  // for using atomic blocks
 
-// frequency of temperature conversions (seconds)
-#define TEMP_CONV_INTERVAL 10
+#ifdef TEMPERATURE_INTERNAL
+// the sensor needs the 1.1 volt reference, which drives the AREF pin;
+// on an unmodified clock, AREF is wired to the 5 volt supply
+#ifndef AREF_ISOLATED
+#error TEMPERATURE_INTERNAL requires the AREF_ISOLATED hardware mod (config.h)
+#endif  // ~AREF_ISOLATED
+
+// seconds between internal temperature sensor readings
+#define TEMP_INTERNAL_INTERVAL 16
+
+// once per period, the adc leaves the photoresistor for a window of
+// sensor conversions, one per semisecond.  after each change of
+// reference, the capacitor on AREF settles through the 32 kohm
+// reference input resistance:  with 100 nF, settling from 5 volts to
+// within half an lsb of 1.1 volts takes ln(3.9 / 0.00054) = 8.9 time
+// constants of 3.2 ms, about 29 ms.  the same time is allowed for AREF
+// to return to AVCC before the next photoresistor burst.
+#define TEMP_INTERNAL_PERIOD  1024  // semiseconds between windows
+#define TEMP_INTERNAL_SETTLE    32  // semiseconds for AREF to settle
+#define TEMP_INTERNAL_SAMPLES   64  // conversions per window
+#define TEMP_INTERNAL_WINDOW \
+    (2 * TEMP_INTERNAL_SETTLE + TEMP_INTERNAL_SAMPLES)
+#else
+// index of crystal sensor in rom search order
+#ifndef XTAL_SENSOR
+#define XTAL_SENSOR 0
+#endif  // ~XTAL_SENSOR
+
+// maximum number of sensors on the 1-wire bus
+#define TEMP_SENSOR_MAX 4
+
+// bounds for interval between temperature conversions (seconds);
+// the interval doubles when temperature is stable and halves when
+// temperature changes quickly
+#define TEMP_CONV_INTERVAL_MIN  2
+#define TEMP_CONV_INTERVAL_MAX 64
+
+// temperature changes (deg C / 16) between conversions
+#define TEMP_CHANGE_SLOW  4  // lengthen interval if change is at most this
+#define TEMP_CHANGE_FAST 16  // use shortest interval if change is this much
+
+// high resolution is used for intervals shorter than this (seconds)
+#define TEMP_HIRES_INTERVAL 16
+
+// sensor configuration register values for conversion resolution
+#define TEMP_RES_10BIT 0x3F  // 0.25 deg C, 188 ms conversion
+#define TEMP_RES_12BIT 0x7F  // 0.0625 deg C, 750 ms conversion
+#endif  // TEMPERATURE_INTERNAL
 
 // constant value for invalid temperature
 #define TEMP_INVALID  INT16_MAX
 
+// time error per second per (deg C / 16)^2 from crystal temperature
+// dependence in units of 2^-43 seconds (1/128 second is 2^36 units)
+#define TEMP_ERROR_COEF ((uint32_t)((XTAL_FREQUENCY_COEF * (1ULL << 35) \
+				     + 500000000) / 1000000000))
+
+#ifdef XTAL_LEARN_CURVE
+// learned crystal curve:  frequency error at evenly spaced temperatures
+#define TEMP_CURVE_SIZE    32    // number of table entries
+#define TEMP_CURVE_MIN     0     // temperature of first entry (deg C / 16)
+#define TEMP_CURVE_STEP    5     // log2 of entry spacing (2 deg C)
+#define TEMP_CURVE_UNSET   0xFFFF  // entry not yet learned
+
+#define TEMP_CURVE_MAX (TEMP_CURVE_MIN \
+			+ ((TEMP_CURVE_SIZE - 1) << TEMP_CURVE_STEP))
+
+// curve learning from gps time
+#define TEMP_LEARN_TIME    8192  // minimum comparison interval (seconds)
+#define TEMP_LEARN_MAX     64    // maximum believable error (1/128 seconds)
+#define TEMP_LEARN_NONE    0xFF  // no comparison in progress
+#endif  // XTAL_LEARN_CURVE
+
 #define TEMP_CONV_STARTED 0x01  // temperature conversion started
 #define TEMP_CONV_INVALID 0x02  // temperature conversion invalid
-#define TEMP_COMM_LOCK    0x04  // communicating with temp sensor
+#define TEMP_READ_PENDING 0x04  // scratchpad read started
+#define TEMP_CONFIG_PENDING 0x08  // sensor resolution must be written
+#define TEMP_SEARCH_PENDING 0x10  // bus must be searched for sensors
+#define TEMP_SEARCH_PASS    0x20  // rom search pass started
+
+#ifndef TEMPERATURE_INTERNAL
+// size of sensor scratchpad, including crc
+#define TEMP_SCRATCH_SIZE 9
+
+// index of configuration register in scratchpad
+#define TEMP_SCRATCH_CONFIG 4
+
+// size of sensor rom code, including crc
+#define TEMP_ROM_SIZE 8
+
+// family code of DS18B20 sensors (first byte of rom code)
+#define TEMP_FAMILY_DS18B20 0x28
+
+// maximum bytes transmitted after reset:  rom command, rom code,
+// function command, and up to three bytes of data
+#define TEMP_TX_SIZE (1 + TEMP_ROM_SIZE + 4)
+
+// 1-WIRE TIMING
+//
+// 1-wire timeslots are counted in timer0 overflows (32 us), and every
+// timer0 compare channel already drives pwm, so temp_onewire() runs
+// from the overflow interrupt.  that interrupt is delayed by anything
+// else running with interrupts disabled:  gps reception, the
+// timekeeping interrupt, and eeprom writes in the main loop, which can
+// hold interrupts off for milliseconds.  the latency is therefore not
+// bounded by design; instead, temp_onewire() detects it and retries:
+//
+// - a late step is recognized by a further overflow already pending
+//   (TOV0 set) on entry; the transaction is abandoned with the bus
+//   pulled high, and the conversion is marked invalid, so a step
+//   counts as on time only if its latency stays below 32 us
+//
+// - each low period ends by waiting until timer0 reaches its count at
+//   the start of the period, so an on-time low period lasts its
+//   nominal length plus less than 32 us:  reset 544-576 us (at least
+//   480 us), write zero 64-96 us (60-120 us), and the presence pulse is
+//   sampled 64-96 us after release
+//
+// - a presence pulse is only guaranteed 60-75 us after release, so a
+//   sample later than that is retried rather than taken as no sensor
+//
+// - failed scratchpad reads (presence, crc, or lateness) are retried
+//   the next second, up to TEMP_READ_RETRIES times, before the
+//   conversion is dropped; failed conversions are restarted the next
+//   second, and failed configuration and searches repeat on their own
+#define TEMP_OW_SAMPLE_LATE 88  // timer0 counts (11 us) after 64 us
+#define TEMP_READ_RETRIES    3  // scratchpad read retries per conversion
+
+// states for 1-wire communication (temp.ow_state)
+enum {
+    TEMP_OW_IDLE,       // no communication in progress
+    TEMP_OW_RESET,      // pull bus low to reset
+    TEMP_OW_PRESENCE,   // release bus for presence pulse
+    TEMP_OW_RECOVER,    // check presence pulse and wait for reset end
+    TEMP_OW_WRITE,      // start write timeslot
+    TEMP_OW_WRITE_END,  // end write timeslot
+    TEMP_OW_READ,       // start read timeslot and sample bus
+    TEMP_OW_READ_END,   // end read timeslot
+    TEMP_OW_SEARCH,     // start search timeslot (read, complement, write)
+    TEMP_OW_SEARCH_END, // end search timeslot
+};
+#endif  // ~TEMPERATURE_INTERNAL
 
 typedef struct {
      int8_t status;      // status flags
     int32_t int_timer;   // seconds between temperature readings
     int32_t conv_timer;  // seconds until next temperature reading
     uint8_t adjust;      // necessary 1/128 second adjustments
-    int32_t error;       // time error [1 / (16^2 * 10^9) seconds]
-    int16_t temp;        // current temperature (16 * deg C)
-     int8_t missed_ovf;  // missed timer0 overflows
+   uint32_t error;       // time error [2^-32 of 1/128 seconds]
+    int16_t temp;        // crystal temperature (16 * deg C)
+
+#ifdef TEMPERATURE_INTERNAL
+    // internal temperature sensor samples since last reading
+   uint32_t adc_sum;     // sum of adc results
+   uint16_t adc_count;   // number of adc results
+#else
+    uint8_t interval;    // seconds between temperature conversions
+    uint8_t resolution;  // sensor configuration register value
+
+    // sensors found on the 1-wire bus, in rom search order
+    uint8_t sensors;     // number of sensors found
+    uint8_t search_last; // position of last search discrepancy
+    uint8_t rom[TEMP_SENSOR_MAX][TEMP_ROM_SIZE];  // sensor rom codes
+    int16_t temps[TEMP_SENSOR_MAX];  // sensor temperatures (16 * deg C)
+
+    // 1-wire communication state, advanced every timer0 overflow
+    uint8_t ow_state;  // current state of 1-wire transaction
+    uint8_t ow_timer;  // timer0 overflows until next state
+    uint8_t ow_tx[TEMP_TX_SIZE];  // bytes transmitted after reset
+    uint8_t ow_txlen;  // number of bytes to transmit
+    uint8_t ow_rxlen;  // number of bytes to receive
+    uint8_t ow_idx;    // bytes transmitted or received
+    uint8_t ow_byte;   // byte being transmitted or received
+    uint8_t ow_bit;    // mask of bit being transmitted or received
+    uint8_t ow_sensor; // sensor being read
+    uint8_t ow_zero;   // last search discrepancy where zero was chosen
+    uint8_t ow_start;  // timer0 count at start of timed period
+    uint8_t retries;   // scratchpad read retries for current conversion
+    uint8_t scratch[TEMP_SENSOR_MAX][TEMP_SCRATCH_SIZE];  // scratchpads
+#endif  // TEMPERATURE_INTERNAL
+
+#ifdef XTAL_LEARN_CURVE
+    // crystal curve, loaded from eeprom or the configured parabola
+    uint16_t curve[TEMP_CURVE_SIZE];  // [2^-30 seconds per second]
+     uint8_t curve_dirty;   // entry to save to eeprom or TEMP_LEARN_NONE
+
+    // comparison of clock and gps time for learning crystal curve
+     uint8_t learn_idx;     // curve entry being learned
+    uint16_t learn_timer;   // seconds since comparison started
+     int32_t learn_offset;  // clock minus gps time at start (1/128 s)
+#endif  // XTAL_LEARN_CURVE
 } temp_t;
 
 
@@ -37,9 +211,37 @@ void temp_sleep(void);
 void temp_tick(void);
 static inline void temp_semitick(void) {};
 
+#ifdef TEMPERATURE_INTERNAL
+static inline void temp_semisemitick(void) {};
+
+// adds an internal temperature sensor sample; called by
+// display_semitick() when the adc is free
+static inline void temp_adc(uint16_t adc) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	temp.adc_sum += adc;
+	++temp.adc_count;
+    }
+}
+#else
+void temp_onewire(void);
+
+// advance 1-wire communication, if any; called every timer0 overflow
+static inline void temp_semisemitick(void) {
+    if(temp.ow_state) temp_onewire();
+}
+#endif  // TEMPERATURE_INTERNAL
+
+int16_t temp_ambient(void);
 int16_t temp_degF(void);
 int16_t temp_degC(void);
 
+#ifdef XTAL_LEARN_CURVE
+uint16_t temp_curve(int16_t t);
+uint16_t temp_curve_entry(uint8_t idx);
+void temp_learn(int32_t offset);
+void temp_learn_reset(void);
+#endif  // XTAL_LEARN_CURVE
+
 #else  // TEMPERATURE_SENSOR
 
 static inline void temp_init(void)     {};
@@ -47,6 +249,7 @@ static inline void temp_wake(void)     {};
 static inline void temp_sleep(void)    {};
 static inline void temp_tick(void)     {};
 static inline void temp_semitick(void) {};
+static inline void temp_semisemitick(void) {};
 
 #endif  // TEMPERATURE_SENSOR
 
@@ -33,6 +33,10 @@ uint8_t ee_time_hour   EEMEM = TIME_DEFAULT_HOUR;
 uint8_t ee_time_minute EEMEM = TIME_DEFAULT_MINUTE;
 uint8_t ee_time_second EEMEM = TIME_DEFAULT_SECOND;
 
+// reserved slot for saving the time quickly on power failure
+uint8_t ee_time_slot[TIME_SLOT_SIZE] EEMEM
+    = { [0 ... TIME_SLOT_SIZE - 1] = 0xFF };
+
 // places to store the date and time display format
 #if TIME_DEFAULT_AUTODST == TIME_AUTODST_USA
 uint8_t ee_time_dateformat       EEMEM =   TIME_DATEFORMAT_SHOWWDAY
@@ -68,17 +72,31 @@ int16_t ee_time_drift_table[TIME_DRIFT_TABLE_SIZE] EEMEM;
 void time_init(void) {
     // eeprom could be uninitialized or corrupted,
     // so force reasonable values for restored data
-    time.year   = eeprom_read_byte(&ee_time_year  ) % 100;
-    time.month  = eeprom_read_byte(&ee_time_month ) % 13;
-    time.day    = eeprom_read_byte(&ee_time_day   ) % 32;
-    time.hour   = eeprom_read_byte(&ee_time_hour  ) % 24;
-    time.minute = eeprom_read_byte(&ee_time_minute) % 60;
-    time.second = eeprom_read_byte(&ee_time_second) % 60;
+    if(eeprom_read_byte(&ee_time_slot[TIME_SLOT_VALID]) == 0) {
+	// time saved on power failure is most recent
+	time.year   = eeprom_read_byte(&ee_time_slot[TIME_SLOT_YEAR  ]) % 100;
+	time.month  = eeprom_read_byte(&ee_time_slot[TIME_SLOT_MONTH ]) % 13;
+	time.day    = eeprom_read_byte(&ee_time_slot[TIME_SLOT_DAY   ]) % 32;
+	time.hour   = eeprom_read_byte(&ee_time_slot[TIME_SLOT_HOUR  ]) % 24;
+	time.minute = eeprom_read_byte(&ee_time_slot[TIME_SLOT_MINUTE]) % 60;
+	time.second = eeprom_read_byte(&ee_time_slot[TIME_SLOT_SECOND]) % 60;
+    } else {
+	time.year   = eeprom_read_byte(&ee_time_year  ) % 100;
+	time.month  = eeprom_read_byte(&ee_time_month ) % 13;
+	time.day    = eeprom_read_byte(&ee_time_day   ) % 32;
+	time.hour   = eeprom_read_byte(&ee_time_hour  ) % 24;
+	time.minute = eeprom_read_byte(&ee_time_minute) % 60;
+	time.second = eeprom_read_byte(&ee_time_second) % 60;
+    }
 
     // for month and day, zero is an invalid value
     if(time.month == 0) time.month = 1;
     if(time.day   == 0) time.day   = 1;
 
+    // calendar is updated every second until sleep
+    time.lazy_due     = 0;
+    time.lazy_seconds = 0;
+
 
 #ifdef AUTODRIFT_CONSTANT
     time.drift_adjust = AUTODRIFT_CONSTANT;
@@ -99,6 +117,12 @@ void time_init(void) {
     time.drift_sleepadjust_timer = 0;
 #endif  // AUTODRIFT_SLEEP
 
+#ifdef TICKLESS_SLEEP
+    time.tickless_seconds = 0;
+    time.tickless_counts  = 0;
+    time.tickless_adjust  = 0;
+#endif  // TICKLESS_SLEEP
+
     time_loadstatus();
     time_loaddateformat();
     time_loadtimeformat();
@@ -130,10 +154,28 @@ void time_init(void) {
 
 // save current time to eeprom
 void time_wake(void) {
+    // resume updating calendar every second
+    time_normalize();
+    time.lazy_due = 0;
+
     // saving time to eeprom doesn't hurt. if something goes wrong, during
     // waking, the watchdog timer will reset the system and the system will
-    // (hopefully) load the correct time after reset
+    // (hopefully) load the correct time after reset.  the date is saved
+    // too, since it may have changed during sleep; unchanged bytes are
+    // not rewritten, so this usually costs nothing
     time_savetime();
+    time_savedate();
+
+    // erase power failure slot while external power is available; only
+    // bytes written by the last power failure are erased (1.8 ms each).
+    // the valid byte is erased first, so the slot is never restored
+    // with partly erased data.  if a reset interrupts this loop, bytes
+    // left unerased are caught by the read-back in time_sleep()
+    for(uint8_t i = TIME_SLOT_SIZE; i--; ) {
+	if(eeprom_read_byte(&ee_time_slot[i]) != 0xFF) {
+	    time_eeprom_split(&ee_time_slot[i], 0xFF, TIME_EEPROM_ERASE);
+	}
+    }
 }
 
 
@@ -142,18 +184,47 @@ void time_sleep(void) {
     // saving time to eeprom doesn't hurt. if the backup battery is dead, power
     // stored in capacitor should be sufficient to save current time.  if the
     // power outage is brief, time will be restored from eeprom and the clock
-    // will still have a semi-reasonable time.
-    time_savetime();
-    time_savedate();
+    // will still have a semi-reasonable time.  the slot was erased on wake,
+    // so each byte takes a 1.8 ms write instead of a 3.4 ms erase and write
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	uint8_t slot[TIME_SLOT_SIZE] = {
+	    time.year, time.month, time.day,
+	    time.hour, time.minute, time.second,
+	    0,  // time is valid once this byte is written
+	};
+
+	uint8_t valid = 1;
+	for(uint8_t i = 0; i < TIME_SLOT_VALID; ++i) {
+	    time_eeprom_split(&ee_time_slot[i], slot[i], TIME_EEPROM_WRITE);
+	}
+
+	// a write cannot set bits, so if the slot was not fully erased
+	// (wake interrupted by a reset), the time read back is wrong;
+	// then erase the valid byte so the regular time bytes are used
+	for(uint8_t i = 0; i < TIME_SLOT_VALID; ++i) {
+	    if(eeprom_read_byte(&ee_time_slot[i]) != slot[i]) valid = 0;
+	}
+
+	if(valid) {
+	    time_eeprom_split(&ee_time_slot[TIME_SLOT_VALID],
+			      slot[TIME_SLOT_VALID], TIME_EEPROM_WRITE);
+	} else {
+	    time_eeprom_split(&ee_time_slot[TIME_SLOT_VALID], 0xFF,
+			      TIME_EEPROM_ERASE);
+	}
+    }
+
+    // defer calendar updates until next hour
+    time.lazy_due = time_nexthour();
 }
 
 
 // save time to eeprom
 void time_savedate(void) {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-	eeprom_write_byte(&ee_time_year,  time.year );
-	eeprom_write_byte(&ee_time_month, time.month);
-	eeprom_write_byte(&ee_time_day,   time.day  );
+	eeprom_update_byte(&ee_time_year,  time.year );
+	eeprom_update_byte(&ee_time_month, time.month);
+	eeprom_update_byte(&ee_time_day,   time.day  );
     }
 }
 
@@ -168,6 +239,20 @@ void time_savetime(void) {
 }
 
 
+// erase or write a single eeprom byte, rather than performing the
+// usual erase-and-write, so either operation takes about half as long
+void time_eeprom_split(uint8_t *addr, uint8_t data, uint8_t mode) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	while(EECR & _BV(EEPE));  // wait for previous operation
+
+	EEAR = (uintptr_t)addr;
+	EEDR = data;
+	EECR = mode | _BV(EEMPE);  // EEPE must be set within four cycles
+	EECR |= _BV(EEPE);
+    }
+}
+
+
 // save status to eeprom
 void time_savestatus(void) {
     eeprom_write_byte(&ee_time_status, time.status);
@@ -285,6 +370,14 @@ void time_settime(uint8_t hour, uint8_t minute, uint8_t second) {
 	time.minute = minute;
 	time.second = second;
 
+	// cancel any time change still being slewed
+	time.slew_adjust = 0;
+
+#ifdef XTAL_LEARN_CURVE
+	// time set, so clock and gps time cannot be compared
+	temp_learn_reset();
+#endif  // XTAL_LEARN_CURVE
+
 	// ensure unset flag is cleared
 	time.status &= ~TIME_UNSET;
     }
@@ -303,8 +396,38 @@ void time_setdate(uint8_t year, uint8_t month, uint8_t day) {
 }
 
 
+// gradually add delta seconds to current time by adjusting the
+// duration of subsequent seconds in time_autodrift()
+void time_slewtime(int8_t delta) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#ifndef AUTODRIFT_CONSTANT
+	// monitor slewed time changes for drift correction,
+	// just as if the time had been set
+	time.drift_delay_timer    = TIME_DRIFT_SAVE_DELAY;
+	time.drift_delta_seconds += delta;
+#endif  // ~AUTODRIFT_CONSTANT
+
+	time.slew_adjust += (int16_t)delta << 7;
+    }
+}
+
+
 // add one second to current time
 void time_tick(void) {
+    // during sleep, count seconds without updating the calendar
+    // until the next hour, when daylight saving time may change
+    if(time.lazy_due > 1) {
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+	    --time.lazy_due;
+	    ++time.lazy_seconds;
+	}
+
+	time_autodrift();
+	return;
+    }
+
+    time_normalize();
+
     ATOMIC_BLOCK(ATOMIC_FORCEON) {
 	++time.second;
 
@@ -317,17 +440,17 @@ void time_tick(void) {
 		if(time.hour >= 24) {
 		    time.hour = 0;
 		    ++time.day;
-		    eeprom_write_byte(&ee_time_day, time.day);
 		    if(time.day > time_daysinmonth(time.year, time.month)) {
 			time.day = 1;
 			++time.month;
-			eeprom_write_byte(&ee_time_month, time.month);
 			if(time.month > 12) {
 			    time.month = 1;
 			    ++time.year;
 			    eeprom_write_byte(&ee_time_year, time.year);
 			}
+			eeprom_write_byte(&ee_time_month, time.month);
 		    }
+		    eeprom_write_byte(&ee_time_day, time.day);
 		}
 	    }
 	}
@@ -336,11 +459,91 @@ void time_tick(void) {
     // run autodst each minute
     if(!time.second) time_autodst(TRUE);
 
+    // during sleep, defer calendar updates until next hour
+    if(time.lazy_due) time.lazy_due = time_nexthour();
+
     // run drift correction
     time_autodrift();
 }
 
 
+// add whole seconds to current time at once; temperature
+// compensation uses this rather than calling time_tick() once per
+// second, so its cost does not grow with the accumulated error
+void time_addseconds(uint32_t seconds) {
+    // during sleep, seconds short of the next hour are deferred
+    if(time.lazy_due > seconds) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {  // also called from interrupt
+	    time.lazy_due     -= seconds;
+	    time.lazy_seconds += seconds;
+	}
+
+	return;
+    }
+
+    time_normalize();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	seconds     += time.second;
+	time.second  = seconds % 60;
+	seconds      = seconds / 60 + time.minute;
+	time.minute  = seconds % 60;
+	seconds      = seconds / 60 + time.hour;
+	time.hour    = seconds % 24;
+
+	// carry whole days into the calendar a month at a time
+	uint32_t days = seconds / 24;
+
+	if(days) {
+	    while(days) {
+		uint8_t left = time_daysinmonth(time.year, time.month)
+			       - time.day;
+
+		if(days <= left) {
+		    time.day += days;
+		    days = 0;
+		} else {
+		    days -= left + 1;
+		    time.day = 1;
+		    if(++time.month > 12) {
+			time.month = 1;
+			++time.year;
+		    }
+		}
+	    }
+
+	    time_savedate();
+	}
+    }
+
+    time_autodst(TRUE);
+
+    // during sleep, defer calendar updates until next hour
+    if(time.lazy_due) time.lazy_due = time_nexthour();
+}
+
+
+// adds seconds deferred during sleep to the calendar; deferred
+// seconds never cross an hour boundary, so only minutes and
+// seconds need updating
+void time_normalize(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	if(time.lazy_seconds) {
+	    uint16_t seconds = time.second + time.lazy_seconds;
+	    time.minute += seconds / 60;
+	    time.second  = seconds % 60;
+	    time.lazy_seconds = 0;
+	}
+    }
+}
+
+
+// returns seconds until the start of the next hour
+uint16_t time_nexthour(void) {
+    return (59 - time.minute) * 60 + (60 - time.second);
+}
+
+
 // return the number of days in the current month
 uint8_t time_daysinmonth(uint8_t year, uint8_t month) {
     // Thirty days hath September,
@@ -747,6 +950,21 @@ void time_autodrift(void) {
 	}
     }
 
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	// shorten or lengthen next "second" to slew time
+	if(time.slew_adjust > 0) {
+	    uint8_t slew = (time.slew_adjust < TIME_SLEW_RATE
+			    ? time.slew_adjust : TIME_SLEW_RATE);
+	    next_OCR2A       -= slew;
+	    time.slew_adjust -= slew;
+	} else if(time.slew_adjust < 0) {
+	    uint8_t slew = (-time.slew_adjust < TIME_SLEW_RATE
+			    ? -time.slew_adjust : TIME_SLEW_RATE);
+	    next_OCR2A       += slew;
+	    time.slew_adjust += slew;
+	}
+    }
+
 #ifdef AUTODRIFT_SLEEP
     if(system.status & SYSTEM_SLEEP) {
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
@@ -775,7 +993,16 @@ void time_autodrift(void) {
     }
 #endif  // AUTODRIFT_SLEEP
 
+#ifdef TICKLESS_SLEEP
+    if(time.tickless_seconds) {
+	// accumulate adjustment for next tickless period
+	time.tickless_adjust += (int16_t)next_OCR2A - 127;
+    } else {
+	OCR2A = next_OCR2A;  // set next OCR2A value
+    }
+#else
     OCR2A = next_OCR2A;  // set next OCR2A value
+#endif  // TICKLESS_SLEEP
 
     if(system.status & SYSTEM_SLEEP) {
 	// if drift adjustment calculation is pending,
@@ -913,3 +1140,112 @@ void time_loaddriftmedian(void) {
     }
 }
 #endif  // ~AUTODRIFT_CONSTANT
+
+
+#ifdef TICKLESS_SLEEP
+// resets the timer2 prescaler after changing the timer2 clock divider,
+// so the first count at the new rate is not cut short by the prescaler
+// state left from the old rate, then waits for pending register writes
+static void time_tickless_prescaler(void) {
+    GTCCR |= _BV(PSRASY);
+    while(GTCCR & _BV(PSRASY));
+    while(ASSR & (_BV(TCN2UB) | _BV(OCR2AUB) | _BV(TCR2BUB)));
+}
+
+
+// returns seconds elapsed since the previous timer2 interrupt during
+// sleep; on the first call, switches timer2 to 1/32 second counts, so
+// a single compare match can span several seconds.  must be called
+// at the start of the interrupt, while TCNT2 is still zero.
+uint8_t time_tickless_elapsed(void) {
+    if(!time.tickless_seconds) {
+	TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);  // divide clock by 1024
+	time_tickless_prescaler();
+	time.tickless_seconds = 1;
+	time.tickless_counts  = 0;
+	time.tickless_adjust  = 0;
+    }
+
+    return time.tickless_seconds;
+}
+
+
+// sets the next timer2 period during sleep to the given number of
+// seconds, applying accumulated drift adjustments in 1/32 seconds;
+// the remainder is carried forward to later periods
+void time_tickless_period(uint8_t seconds) {
+    if(seconds > TIME_TICKLESS_MAX) seconds = TIME_TICKLESS_MAX;
+
+    int16_t base = ((int16_t)seconds << 5) - 1;
+    int16_t top  = base + time.tickless_adjust / 4;
+
+    if(top < TIME_TICKLESS_TOP_MIN) top = TIME_TICKLESS_TOP_MIN;
+    if(top > UINT8_MAX) top = UINT8_MAX;
+
+    time.tickless_counts   = top - base;
+    time.tickless_adjust  -= (top - base) << 2;
+    time.tickless_seconds  = seconds;
+
+    OCR2A = top;
+}
+
+
+// when external power is restored between timer2 interrupts, ends
+// the current period at the next whole second, so the seconds already
+// elapsed are counted; returns nonzero if the caller must wait for
+// the timer2 interrupt before calling time_tickless_stop()
+uint8_t time_tickless_shorten(void) {
+    if(!time.tickless_seconds) return 0;
+
+    // wait for pending writes to timer2 registers
+    while(ASSR & (_BV(TCN2UB) | _BV(OCR2AUB) | _BV(TCR2BUB)));
+
+    // within the first second, time_tickless_stop() keeps the fraction
+    uint8_t count = TCNT2;
+    if(count < 32) return 0;
+
+    // end period at the next second; if that second is nearly
+    // over, at the following second, so the compare match is not
+    // missed while the OCR2A write is synchronized
+    uint16_t top = count | 31;
+    if((count & 31) >= 30) top += 32;
+
+    // the period will end sooner without OCR2A changes
+    if(top >= OCR2A) return 1;
+
+    // return adjustment from the abandoned top to later periods
+    time.tickless_adjust += (int16_t)time.tickless_counts << 2;
+    time.tickless_counts  = 0;
+    time.tickless_seconds = (top + 1) >> 5;
+
+    OCR2A = top;
+
+    return 1;
+}
+
+
+// returns timer2 to one interrupt per second; called immediately
+// after a timer2 interrupt or within the first second of a period
+// when external power is restored
+void time_tickless_stop(void) {
+    if(!time.tickless_seconds) return;
+
+    // wait for pending writes to timer2 registers
+    while(ASSR & (_BV(TCN2UB) | _BV(OCR2AUB) | _BV(TCR2BUB)));
+
+    uint8_t count = TCNT2;
+    TCCR2B = _BV(CS22) | _BV(CS21);  // divide clock by 256
+    time_tickless_prescaler();
+    TCNT2  = count << 2;
+    OCR2A  = 127;  // 128 values, including zero
+
+    // the current period is abandoned, so slew all adjustments
+    // not yet applied; positive slew_adjust shortens seconds
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	time.slew_adjust -= time.tickless_adjust
+			    + ((int16_t)time.tickless_counts << 2);
+    }
+
+    time.tickless_seconds = 0;
+}
+#endif  // TICKLESS_SLEEP
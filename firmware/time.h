@@ -54,6 +54,34 @@
 #define TIME_MIN_DRIFT_TIME   15   // seconds
 #define TIME_DRIFT_SAVE_DELAY 600  // seconds (10 min)
 
+// time slewing limits
+#define TIME_SLEW_MAX  4   // seconds; larger time changes set the time
+#define TIME_SLEW_RATE 16  // maximum slew per second (1/128 seconds)
+
+#ifdef TICKLESS_SLEEP
+// longest timer2 period during sleep; at 32 counts per second, the
+// period must leave room in OCR2A for lengthening adjustments
+#define TIME_TICKLESS_MAX 7    // seconds
+#define TIME_TICKLESS_TOP_MIN 16  // shortest period (1/32 seconds)
+#endif  // TICKLESS_SLEEP
+
+// layout of the eeprom slot reserved for saving the time on power
+// failure; the slot is erased in advance, so bytes need only be written
+enum {
+    TIME_SLOT_YEAR,
+    TIME_SLOT_MONTH,
+    TIME_SLOT_DAY,
+    TIME_SLOT_HOUR,
+    TIME_SLOT_MINUTE,
+    TIME_SLOT_SECOND,
+    TIME_SLOT_VALID,  // zero when time is saved; written last
+    TIME_SLOT_SIZE,
+};
+
+// eeprom programming modes for time_eeprom_split()
+#define TIME_EEPROM_ERASE _BV(EEPM0)  // set byte to 0xFF (1.8 ms)
+#define TIME_EEPROM_WRITE _BV(EEPM1)  // clear bits only (1.8 ms)
+
 // flags for time.status
 #define TIME_UNSET		0x01
 #define TIME_DST		0x02
@@ -135,6 +163,28 @@ typedef struct {
     // drift_adjust_timer equals zero, time is adjusted by 1/128
     // seconds and the timer is reset to abs(drift_adjust).
 
+    uint16_t lazy_due;  // during sleep, seconds until the calendar
+    // must next be updated (at the start of the next hour); zero
+    // when calendar is updated every second
+
+    uint16_t lazy_seconds;  // seconds elapsed during sleep that have
+    // not yet been added to the calendar
+
+    int16_t slew_adjust;  // 1/128 seconds remaining to add to current
+    // time; positive values shorten subsequent seconds; negative values,
+    // lengthen; at most TIME_SLEW_RATE is applied each second
+
+#ifdef TICKLESS_SLEEP
+    uint8_t tickless_seconds;  // duration of current timer2 period during
+    // sleep in seconds; zero when timer2 interrupts every second
+
+    int8_t tickless_counts;  // adjustment applied to current timer2
+    // period in 1/32 seconds; positive values lengthen the period
+
+    int16_t tickless_adjust;  // adjustment to apply to later timer2
+    // periods in 1/128 seconds; positive values lengthen periods
+#endif  // TICKLESS_SLEEP
+
 #ifdef AUTODRIFT_SLEEP
     uint16_t drift_sleepadjust_timer;  // like drift_adjust timer,
     // but for the additional drift correction applied during sleep
@@ -166,11 +216,17 @@ void time_wake(void);
 void time_sleep(void);
 
 void time_tick(void);
+void time_addseconds(uint32_t seconds);
 static inline void time_semitick(void) {};
 
+void time_normalize(void);
+uint16_t time_nexthour(void);
+
 void time_savetime(void);
 void time_savedate(void);
 
+void time_eeprom_split(uint8_t *addr, uint8_t data, uint8_t mode);
+
 void time_savestatus(void);
 void time_loadstatus(void);
 
@@ -182,6 +238,7 @@ void time_loadtimeformat(void);
 
 void time_settime(const uint8_t hour, const uint8_t minute, const uint8_t second);
 void time_setdate(uint8_t year, uint8_t month, uint8_t day);
+void time_slewtime(int8_t delta);
 
 uint8_t time_dayofweek(uint8_t year, uint8_t month, uint8_t day);
 uint8_t time_daysinmonth(uint8_t year, uint8_t month);
@@ -199,6 +256,17 @@ uint8_t time_isdst_usa(void);
 
 void time_autodrift(void);
 
+#ifdef TICKLESS_SLEEP
+uint8_t time_tickless_elapsed(void);
+void time_tickless_period(uint8_t seconds);
+uint8_t time_tickless_shorten(void);
+void time_tickless_stop(void);
+#else
+static inline uint8_t time_tickless_elapsed(void) { return 1; };
+static inline uint8_t time_tickless_shorten(void) { return 0; };
+static inline void time_tickless_stop(void) {};
+#endif  // TICKLESS_SLEEP
+
 #ifndef AUTODRIFT_CONSTANT
 void time_newdrift(void);
 void time_loaddriftmedian(void);